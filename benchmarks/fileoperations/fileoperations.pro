@@ -0,0 +1,61 @@
+TEMPLATE = app
+TARGET   = fileoperations_benchmark
+DESTDIR  = ../../bin
+
+QT = core gui widgets #gui and widgets are required by the core library (QFileIconProvider)
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = ../../build/fileoperations_benchmark
+MOC_DIR     = ../../build/fileoperations_benchmark
+UI_DIR      = ../../build/fileoperations_benchmark
+RCC_DIR     = ../../build/fileoperations_benchmark
+
+INCLUDEPATH += \
+	$$PWD/src/ \
+	../../file-commander-core/src \
+	../../file-commander-core/include \
+	../../qtutils \
+	../../cpputils
+
+HEADERS += \
+	src/cautorespondingobserver.h \
+	src/cbenchmarktreegenerator.h \
+	src/processstatistics.h
+
+SOURCES += \
+	src/main.cpp \
+	src/cautorespondingobserver.cpp \
+	src/cbenchmarktreegenerator.cpp \
+	src/processstatistics.cpp
+
+DEFINES += _SCL_SECURE_NO_WARNINGS
+
+LIBS += -L../../bin -lcore -lqtutils -lcpputils
+
+win*{
+	QT += winextras
+	LIBS += -lole32 -lShell32 -lUser32 -lPsapi
+	QMAKE_CXXFLAGS += /MP /wd4251
+	QMAKE_CXXFLAGS_WARN_ON = /W4
+	DEFINES += WIN32_LEAN_AND_MEAN NOMINMAX
+}
+
+linux*|mac*{
+	QMAKE_CXXFLAGS_WARN_ON = -Wall -Wno-c++11-extensions -Wno-local-type-template-args -Wno-deprecated-register
+
+	CONFIG(release, debug|release):CONFIG += Release
+	CONFIG(debug, debug|release):CONFIG += Debug
+
+	Release:DEFINES += NDEBUG=1
+	Debug:DEFINES += _DEBUG
+}
+
+win32*:!*msvc2012:*msvc* {
+	QMAKE_CXXFLAGS += /FS
+}
+
+mac*|linux*{
+	PRE_TARGETDEPS += $${DESTDIR}/libcore.a
+}
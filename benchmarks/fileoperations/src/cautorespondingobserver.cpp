@@ -0,0 +1,78 @@
+#include "cautorespondingobserver.h"
+
+#include <chrono>
+#include <thread>
+
+CAutoRespondingObserver::CAutoRespondingObserver(COperationPerformer& performer) :
+	_performer(performer),
+	_numHalts(0),
+	_finished(false)
+{
+}
+
+void CAutoRespondingObserver::onProgressChanged(float /*totalPercentage*/, size_t /*numFilesProcessed*/, size_t /*totalNumFiles*/, float /*filePercentage*/, uint64_t /*speed*/)
+{
+}
+
+void CAutoRespondingObserver::onProcessHalted(HaltReason reason, CFileSystemObject /*source*/, CFileSystemObject /*dest*/, QString /*errorMessage*/)
+{
+	++_numHalts;
+
+	// Overwriting is what a user re-running the same copy would normally choose; errors are skipped so that the run can complete
+	switch (reason)
+	{
+	case hrFileExists:
+	case hrSourceFileIsReadOnly:
+	case hrDestFileIsReadOnly:
+		_performer.userResponse(reason, urProceedWithAll);
+		break;
+	default:
+		_performer.userResponse(reason, urSkipAll);
+		break;
+	}
+}
+
+void CAutoRespondingObserver::onProcessFinished(QString message)
+{
+	_finishedMessage = message;
+	_finished = true;
+}
+
+void CAutoRespondingObserver::onCurrentFileChanged(QString /*file*/)
+{
+}
+
+// Processes the callbacks queued by the performer until the operation is finished
+void CAutoRespondingObserver::waitForCompletion()
+{
+	while (!_finished)
+	{
+		processCallbacks();
+		if (!_finished)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+// The number of times the operation was halted and required a response
+size_t CAutoRespondingObserver::numHalts() const
+{
+	return _numHalts;
+}
+
+QString CAutoRespondingObserver::finishedMessage() const
+{
+	return _finishedMessage;
+}
+
+void CAutoRespondingObserver::processCallbacks()
+{
+	// Callbacks may respond to the performer, which in turn may queue more callbacks, so they must not be run under the lock
+	std::vector<std::function<void ()>> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(_callbackMutex);
+		callbacks.swap(_callbacks);
+	}
+
+	for (const auto& callback: callbacks)
+		callback();
+}
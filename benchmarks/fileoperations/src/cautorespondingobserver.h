@@ -0,0 +1,31 @@
+#pragma once
+
+#include "fileoperations/coperationperformer.h"
+
+// Drives a COperationPerformer without UI: answers every prompt automatically and runs the queued callbacks on the calling thread
+class CAutoRespondingObserver : public CFileOperationObserver
+{
+public:
+	explicit CAutoRespondingObserver(COperationPerformer& performer);
+
+	void onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed /* B/s*/) override;
+	void onProcessHalted(HaltReason reason, CFileSystemObject source, CFileSystemObject dest, QString errorMessage) override;
+	void onProcessFinished(QString message = QString()) override;
+	void onCurrentFileChanged(QString file) override;
+
+	// Processes the callbacks queued by the performer until the operation is finished
+	void waitForCompletion();
+
+	// The number of times the operation was halted and required a response
+	size_t numHalts() const;
+	QString finishedMessage() const;
+
+private:
+	void processCallbacks();
+
+private:
+	COperationPerformer& _performer;
+	QString              _finishedMessage;
+	size_t               _numHalts;
+	bool                 _finished;
+};
@@ -0,0 +1,216 @@
+#include "cbenchmarktreegenerator.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static const size_t blockSize = 1024 * 1024;
+
+CBenchmarkTreeGenerator::CBenchmarkTreeGenerator(const QString& rootPath, uint32_t seed) :
+	_rootPath(rootPath),
+	_rng(seed),
+	_block(blockSize)
+{
+	std::uniform_int_distribution<int> byteDistribution(0, 255);
+	for (char& byte: _block)
+		byte = (char)byteDistribution(_rng);
+}
+
+// Many small files of random size up to maxFileSize in a flat folder
+CBenchmarkTreeGenerator::TreeInfo CBenchmarkTreeGenerator::generateTinyFiles(const QString& name, size_t numFiles, uint64_t maxFileSize)
+{
+	TreeInfo info;
+	info.path = _rootPath + '/' + name;
+	if (!createFolder(info.path, info))
+		return info;
+
+	std::uniform_int_distribution<uint64_t> sizeDistribution(0, maxFileSize);
+	for (size_t i = 0; i < numFiles; ++i)
+	{
+		if (!writeFile(info.path + QString("/tiny_%1.bin").arg(i), sizeDistribution(_rng), info))
+			return info;
+	}
+
+	info.valid = true;
+	return info;
+}
+
+// A few large files
+CBenchmarkTreeGenerator::TreeInfo CBenchmarkTreeGenerator::generateHugeFiles(const QString& name, size_t numFiles, uint64_t fileSize)
+{
+	TreeInfo info;
+	info.path = _rootPath + '/' + name;
+	if (!createFolder(info.path, info))
+		return info;
+
+	for (size_t i = 0; i < numFiles; ++i)
+	{
+		if (!writeFile(info.path + QString("/huge_%1.bin").arg(i), fileSize, info))
+			return info;
+	}
+
+	info.valid = true;
+	return info;
+}
+
+// A chain of nested folders with a few files on every level
+CBenchmarkTreeGenerator::TreeInfo CBenchmarkTreeGenerator::generateDeepNesting(const QString& name, size_t depth, size_t filesPerLevel, uint64_t fileSize)
+{
+	TreeInfo info;
+	info.path = _rootPath + '/' + name;
+	if (!createFolder(info.path, info))
+		return info;
+
+	QString levelPath = info.path;
+	for (size_t level = 0; level < depth; ++level)
+	{
+		levelPath += QString("/level_%1").arg(level);
+		if (!createFolder(levelPath, info))
+			return info;
+
+		for (size_t i = 0; i < filesPerLevel; ++i)
+		{
+			if (!writeFile(levelPath + QString("/file_%1.bin").arg(i), fileSize, info))
+				return info;
+		}
+	}
+
+	info.valid = true;
+	return info;
+}
+
+// Files of the specified logical size with only a couple of blocks of actual data
+CBenchmarkTreeGenerator::TreeInfo CBenchmarkTreeGenerator::generateSparseFiles(const QString& name, size_t numFiles, uint64_t fileSize)
+{
+	TreeInfo info;
+	info.path = _rootPath + '/' + name;
+	if (!createFolder(info.path, info))
+		return info;
+
+	const uint64_t dataSize = std::min<uint64_t>(4096, fileSize);
+	for (size_t i = 0; i < numFiles; ++i)
+	{
+		QFile file(info.path + QString("/sparse_%1.bin").arg(i));
+		// Extending the file without writing creates a hole on the file systems that support it
+		if (!file.open(QFile::WriteOnly) || !file.resize((qint64)fileSize))
+		{
+			qDebug() << "Failed to create" << file.fileName() << ":" << file.errorString();
+			return info;
+		}
+
+		// A bit of data at the start and in the middle
+		const uint64_t offsets[] = {0, fileSize / 2};
+		for (const uint64_t offset: offsets)
+		{
+			if (!file.seek((qint64)offset) || file.write(_block.data(), (qint64)dataSize) != (qint64)dataSize)
+			{
+				qDebug() << "Failed to write" << file.fileName() << ":" << file.errorString();
+				return info;
+			}
+		}
+
+		++info.numFiles;
+		info.totalSize += std::max(fileSize, fileSize / 2 + dataSize);
+	}
+
+	info.valid = true;
+	return info;
+}
+
+// numInodes files, each of which has linksPerInode names (hard links) spread over two folders
+CBenchmarkTreeGenerator::TreeInfo CBenchmarkTreeGenerator::generateHardlinks(const QString& name, size_t numInodes, size_t linksPerInode, uint64_t fileSize)
+{
+	TreeInfo info;
+	info.path = _rootPath + '/' + name;
+	const QString originalsPath = info.path + "/originals", linksPath = info.path + "/links";
+	if (!createFolder(info.path, info) || !createFolder(originalsPath, info) || !createFolder(linksPath, info))
+		return info;
+
+	for (size_t i = 0; i < numInodes; ++i)
+	{
+		const QString originalPath = originalsPath + QString("/file_%1.bin").arg(i);
+		if (!writeFile(originalPath, fileSize, info))
+			return info;
+
+		for (size_t link = 1; link < linksPerInode; ++link)
+		{
+			if (!createHardlink(originalPath, linksPath + QString("/file_%1_link_%2.bin").arg(i).arg(link), fileSize, info))
+				return info;
+		}
+	}
+
+	info.valid = true;
+	return info;
+}
+
+bool CBenchmarkTreeGenerator::createFolder(const QString& path, TreeInfo& info)
+{
+	if (!QDir().mkpath(path))
+	{
+		qDebug() << "Failed to create folder" << path;
+		return false;
+	}
+
+	++info.numFolders;
+	return true;
+}
+
+bool CBenchmarkTreeGenerator::writeFile(const QString& path, uint64_t size, TreeInfo& info)
+{
+	QFile file(path);
+	if (!file.open(QFile::WriteOnly))
+	{
+		qDebug() << "Failed to create" << path << ":" << file.errorString();
+		return false;
+	}
+
+	// Stamping every block with unique numbers so that no two blocks in the tree are identical
+	++_fileCounter;
+	uint64_t blockIndex = 0;
+	for (uint64_t written = 0; written < size; written += blockSize, ++blockIndex)
+	{
+		memcpy(_block.data(), &_fileCounter, sizeof(_fileCounter));
+		memcpy(_block.data() + sizeof(_fileCounter), &blockIndex, sizeof(blockIndex));
+
+		const qint64 chunkSize = (qint64)std::min<uint64_t>(blockSize, size - written);
+		if (file.write(_block.data(), chunkSize) != chunkSize)
+		{
+			qDebug() << "Failed to write" << path << ":" << file.errorString();
+			return false;
+		}
+	}
+
+	++info.numFiles;
+	info.totalSize += size;
+	return true;
+}
+
+bool CBenchmarkTreeGenerator::createHardlink(const QString& existingPath, const QString& linkPath, uint64_t size, TreeInfo& info)
+{
+#ifdef _WIN32
+	const bool succeeded = CreateHardLinkW((LPCWSTR)QDir::toNativeSeparators(linkPath).utf16(), (LPCWSTR)QDir::toNativeSeparators(existingPath).utf16(), nullptr) != FALSE;
+#else
+	const bool succeeded = ::link(existingPath.toUtf8().constData(), linkPath.toUtf8().constData()) == 0;
+#endif
+
+	if (!succeeded)
+	{
+		qDebug() << "Failed to link" << linkPath << "to" << existingPath;
+		return false;
+	}
+
+	++info.numFiles;
+	info.totalSize += size;
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+// Generates synthetic directory trees for benchmarking file operations. The same seed always produces the same trees.
+class CBenchmarkTreeGenerator
+{
+public:
+	struct TreeInfo
+	{
+		QString  path;
+		uint64_t numFiles = 0;   // Including every hard link
+		uint64_t numFolders = 0; // Including the root
+		uint64_t totalSize = 0;  // Logical size of all the files, hard links counted once per link
+		bool     valid = false;
+	};
+
+	explicit CBenchmarkTreeGenerator(const QString& rootPath, uint32_t seed = 42);
+
+	// Many small files of random size up to maxFileSize in a flat folder
+	TreeInfo generateTinyFiles(const QString& name, size_t numFiles, uint64_t maxFileSize);
+	// A few large files
+	TreeInfo generateHugeFiles(const QString& name, size_t numFiles, uint64_t fileSize);
+	// A chain of nested folders with a few files on every level
+	TreeInfo generateDeepNesting(const QString& name, size_t depth, size_t filesPerLevel, uint64_t fileSize);
+	// Files of the specified logical size with only a couple of blocks of actual data
+	TreeInfo generateSparseFiles(const QString& name, size_t numFiles, uint64_t fileSize);
+	// numInodes files, each of which has linksPerInode names (hard links) spread over two folders
+	TreeInfo generateHardlinks(const QString& name, size_t numInodes, size_t linksPerInode, uint64_t fileSize);
+
+private:
+	bool createFolder(const QString& path, TreeInfo& info);
+	bool writeFile(const QString& path, uint64_t size, TreeInfo& info);
+	bool createHardlink(const QString& existingPath, const QString& linkPath, uint64_t size, TreeInfo& info);
+
+private:
+	const QString     _rootPath;
+	std::mt19937      _rng;
+	std::vector<char> _block;
+	uint64_t          _fileCounter = 0;
+};
@@ -0,0 +1,202 @@
+#include "cautorespondingobserver.h"
+#include "cbenchmarktreegenerator.h"
+#include "processstatistics.h"
+#include "fileoperations/coperationperformer.h"
+#include "assert/advanced_assert.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QTemporaryDir>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+
+// File operation benchmark.
+// Generates synthetic source trees, copies and deletes them with COperationPerformer and prints the measurements as JSON.
+// The source trees are written right before being copied, so the copy is measured with a warm page cache for the source.
+
+static bool verboseOutput = false;
+
+static void messageHandler(QtMsgType type, const QMessageLogContext& /*context*/, const QString& message)
+{
+	// COperationPerformer logs every file it processes; printing that would distort the measurements
+	if (type == QtDebugMsg && !verboseOutput)
+		return;
+
+	fprintf(stderr, "%s\n", message.toLocal8Bit().constData());
+}
+
+static QJsonObject runOperation(const QString& scenario, const QString& operationName, Operation operation, const QString& sourcePath, const QString& destination, const CBenchmarkTreeGenerator::TreeInfo& tree, bool preserveHardlinks)
+{
+	COperationPerformer performer(operation, std::vector<CFileSystemObject>(1, CFileSystemObject(sourcePath)), destination);
+	performer.setPreserveHardlinks(preserveHardlinks);
+	CAutoRespondingObserver observer(performer);
+	performer.setWatcher(&observer);
+
+	// Otherwise the peak of an earlier operation (or of the tree generation) would be reported for this one
+	const bool peakRssIsPerOperation = ProcessStatistics::resetPeakRss();
+	const ProcessStatistics statsBefore = ProcessStatistics::current();
+	const auto start = std::chrono::steady_clock::now();
+
+	performer.start();
+	observer.waitForCompletion();
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const ProcessStatistics stats = ProcessStatistics::current() - statsBefore;
+
+	QJsonObject result;
+	result["scenario"] = scenario;
+	result["operation"] = operationName;
+	result["files"] = (double)tree.numFiles;
+	result["folders"] = (double)tree.numFolders;
+	result["bytes"] = (double)tree.totalSize;
+	result["seconds"] = seconds;
+	// Deleting costs per entry regardless of the file sizes, so its throughput is in items rather than bytes
+	const bool isDelete = operation == operationDelete;
+	if (isDelete)
+		result["itemsPerSecond"] = seconds > 0.0 ? (tree.numFiles + tree.numFolders) / seconds : 0.0;
+	else
+		result["mbPerSecond"] = seconds > 0.0 ? tree.totalSize / (1024.0 * 1024.0) / seconds : 0.0;
+	result["filesPerSecond"] = seconds > 0.0 ? tree.numFiles / seconds : 0.0;
+	result["readSyscalls"] = (double)stats.readSyscalls;
+	result["writeSyscalls"] = (double)stats.writeSyscalls;
+	result["storageBytesRead"] = (double)stats.storageBytesRead;
+	result["storageBytesWritten"] = (double)stats.storageBytesWritten;
+	// Where the peak can't be reset it's the peak of the whole benchmark run so far, and is named accordingly
+	result[peakRssIsPerOperation ? "peakRssBytes" : "processPeakRssBytes"] = (double)stats.peakRss;
+	result["halts"] = (double)observer.numHalts();
+
+	const QString throughput = isDelete ? QString("%1 items/s").arg(result["itemsPerSecond"].toDouble(), 0, 'f', 0) : QString("%1 MiB/s").arg(result["mbPerSecond"].toDouble(), 0, 'f', 1);
+	qWarning().noquote() << QString("%1 / %2: %3 s, %4, %5 files/s").arg(scenario, operationName).arg(seconds, 0, 'f', 3).
+		arg(throughput).arg(result["filesPerSecond"].toDouble(), 0, 'f', 0);
+
+	return result;
+}
+
+struct Scenario
+{
+	QString name;
+	std::function<CBenchmarkTreeGenerator::TreeInfo (CBenchmarkTreeGenerator&, const QString& name)> generate;
+	bool hasHardlinks;
+};
+
+int main(int argc, char *argv[])
+{
+	AdvancedAssert::setLoggingFunc([](const char* message){
+		fprintf(stderr, "%s\n", message);
+	});
+
+	QCoreApplication app(argc, argv);
+	app.setApplicationName("File Commander file operations benchmark");
+	qInstallMessageHandler(messageHandler);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Copies and deletes synthetic directory trees with COperationPerformer and reports throughput, syscall counts and peak RSS as JSON.");
+	parser.addHelpOption();
+	const QCommandLineOption scaleOption("scale", "Multiplier for the number and size of the generated files (default 1.0).", "factor", "1.0");
+	const QCommandLineOption workDirOption("work-dir", "Folder to generate the trees in (default: a new temporary folder).", "path");
+	const QCommandLineOption outputOption("output", "Write the JSON report to this file instead of stdout.", "file");
+	const QCommandLineOption scenarioOption("scenario", "Only run the specified scenario; can be repeated. Available: tiny, huge, deep, sparse, hardlinks.", "name");
+	const QCommandLineOption seedOption("seed", "Random seed for the generated trees (default 42).", "seed", "42");
+	const QCommandLineOption verboseOption("verbose", "Print the debug output of the file operations.");
+	parser.addOptions({scaleOption, workDirOption, outputOption, scenarioOption, seedOption, verboseOption});
+	parser.process(app);
+
+	verboseOutput = parser.isSet(verboseOption);
+	const double scale = parser.value(scaleOption).toDouble();
+	if (scale <= 0.0)
+	{
+		qCritical() << "Invalid scale" << parser.value(scaleOption);
+		return 1;
+	}
+
+	const auto scaled = [scale](uint64_t value) -> uint64_t {
+		return std::max<uint64_t>(1, (uint64_t)(value * scale));
+	};
+
+	const uint64_t KB = 1024, MB = 1024 * KB;
+	const std::vector<Scenario> scenarios = {
+		{"tiny", [&](CBenchmarkTreeGenerator& g, const QString& name) {return g.generateTinyFiles(name, (size_t)scaled(20000), 4 * KB);}, false},
+		{"huge", [&](CBenchmarkTreeGenerator& g, const QString& name) {return g.generateHugeFiles(name, 3, scaled(512 * MB));}, false},
+		{"deep", [&](CBenchmarkTreeGenerator& g, const QString& name) {return g.generateDeepNesting(name, (size_t)scaled(100), 5, 16 * KB);}, false},
+		{"sparse", [&](CBenchmarkTreeGenerator& g, const QString& name) {return g.generateSparseFiles(name, 4, scaled(256 * MB));}, false},
+		{"hardlinks", [&](CBenchmarkTreeGenerator& g, const QString& name) {return g.generateHardlinks(name, (size_t)scaled(1000), 4, 64 * KB);}, true}
+	};
+
+	const QStringList selectedScenarios = parser.values(scenarioOption);
+
+	QTemporaryDir temporaryDir;
+	const QString workDir = parser.isSet(workDirOption) ? parser.value(workDirOption) : temporaryDir.path();
+	const QString sourceRoot = workDir + "/source", destRoot = workDir + "/dest";
+	if (workDir.isEmpty() || !QDir().mkpath(sourceRoot) || !QDir().mkpath(destRoot))
+	{
+		qCritical() << "Failed to create the work folder" << workDir;
+		return 1;
+	}
+
+	CBenchmarkTreeGenerator generator(sourceRoot, parser.value(seedOption).toUInt());
+	QJsonArray results;
+	for (const auto& scenario: scenarios)
+	{
+		if (!selectedScenarios.isEmpty() && !selectedScenarios.contains(scenario.name))
+			continue;
+
+		const CBenchmarkTreeGenerator::TreeInfo tree = scenario.generate(generator, scenario.name);
+		if (!tree.valid)
+		{
+			qCritical() << "Failed to generate the source tree for" << scenario.name;
+			return 1;
+		}
+
+		// Trailing slash: copying into the folder rather than to a new name
+		const QString copiedTreePath = destRoot + '/' + scenario.name;
+		results.append(runOperation(scenario.name, "copy", operationCopy, tree.path, destRoot + '/', tree, false));
+		results.append(runOperation(scenario.name, "delete", operationDelete, copiedTreePath, workDir, tree, false));
+
+		if (scenario.hasHardlinks)
+		{
+			results.append(runOperation(scenario.name, "copy_preserve_hardlinks", operationCopy, tree.path, destRoot + '/', tree, true));
+			results.append(runOperation(scenario.name, "delete_preserved_hardlinks", operationDelete, copiedTreePath, workDir, tree, false));
+		}
+
+		QDir(tree.path).removeRecursively();
+		QDir(copiedTreePath).removeRecursively();
+	}
+
+	QJsonObject report;
+	report["benchmark"] = QString("fileoperations");
+	report["formatVersion"] = 3;
+	report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+	report["platform"] = QSysInfo::prettyProductName();
+	report["qtVersion"] = QString(qVersion());
+	report["scale"] = scale;
+	report["seed"] = (double)parser.value(seedOption).toUInt();
+	report["results"] = results;
+
+	const QByteArray json = QJsonDocument(report).toJson();
+	if (parser.isSet(outputOption))
+	{
+		QFile output(parser.value(outputOption));
+		if (!output.open(QFile::WriteOnly) || output.write(json) != json.size())
+		{
+			qCritical() << "Failed to write" << output.fileName() << ":" << output.errorString();
+			return 1;
+		}
+	}
+	else
+		fwrite(json.constData(), 1, (size_t)json.size(), stdout);
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include "processstatistics.h"
+
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+ProcessStatistics ProcessStatistics::current()
+{
+	ProcessStatistics stats;
+
+#ifdef __linux__
+	std::ifstream io("/proc/self/io");
+	std::string key;
+	int64_t value = 0;
+	while (io >> key >> value)
+	{
+		if (key == "syscr:")
+			stats.readSyscalls = value;
+		else if (key == "syscw:")
+			stats.writeSyscalls = value;
+		else if (key == "read_bytes:")
+			stats.storageBytesRead = value;
+		else if (key == "write_bytes:")
+			stats.storageBytesWritten = value;
+	}
+
+	// Unlike ru_maxrss, VmHWM is reset by resetPeakRss()
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, 6, "VmHWM:") == 0)
+		{
+			stats.peakRss = std::stoll(line.substr(6)) * 1024; // Reported in kB
+			break;
+		}
+	}
+#endif
+
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS memoryCounters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters)))
+		stats.peakRss = (int64_t)memoryCounters.PeakWorkingSetSize;
+
+	IO_COUNTERS ioCounters;
+	if (GetProcessIoCounters(GetCurrentProcess(), &ioCounters))
+	{
+		stats.readSyscalls = (int64_t)ioCounters.ReadOperationCount;
+		stats.writeSyscalls = (int64_t)ioCounters.WriteOperationCount;
+	}
+#else
+	struct rusage usage;
+	if (stats.peakRss < 0 && getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+#ifdef __APPLE__
+		stats.peakRss = (int64_t)usage.ru_maxrss; // Bytes on OS X
+#else
+		stats.peakRss = (int64_t)usage.ru_maxrss * 1024; // KiB on Linux
+#endif
+	}
+#endif
+
+	return stats;
+}
+
+bool ProcessStatistics::resetPeakRss()
+{
+#ifdef __linux__
+	std::ofstream clearRefs("/proc/self/clear_refs");
+	clearRefs << "5";
+	clearRefs.flush();
+	return clearRefs.good();
+#else
+	return false;
+#endif
+}
+
+static inline int64_t counterDelta(int64_t later, int64_t earlier)
+{
+	return (later >= 0 && earlier >= 0) ? later - earlier : -1;
+}
+
+ProcessStatistics ProcessStatistics::operator-(const ProcessStatistics& earlier) const
+{
+	ProcessStatistics delta;
+	delta.readSyscalls = counterDelta(readSyscalls, earlier.readSyscalls);
+	delta.writeSyscalls = counterDelta(writeSyscalls, earlier.writeSyscalls);
+	delta.storageBytesRead = counterDelta(storageBytesRead, earlier.storageBytesRead);
+	delta.storageBytesWritten = counterDelta(storageBytesWritten, earlier.storageBytesWritten);
+	delta.peakRss = peakRss;
+	return delta;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// A snapshot of the resource usage of the current process. Counters that are not available on the current platform are set to -1.
+struct ProcessStatistics
+{
+	// Number of read / write syscalls issued (Linux: /proc/self/io)
+	int64_t readSyscalls = -1;
+	int64_t writeSyscalls = -1;
+	// Bytes actually fetched from / sent to the storage layer
+	int64_t storageBytesRead = -1;
+	int64_t storageBytesWritten = -1;
+	// Peak resident set size since the process start or the last successful resetPeakRss() call, bytes
+	int64_t peakRss = -1;
+
+	static ProcessStatistics current();
+	// Resets the peak RSS to the current RSS (Linux: /proc/self/clear_refs). Returns false where not supported, peakRss is then the process lifetime peak.
+	static bool resetPeakRss();
+	// Returns the difference between two snapshots for the cumulative counters; peakRss is taken from the later snapshot as is
+	ProcessStatistics operator-(const ProcessStatistics& earlier) const;
+};
@@ -21,6 +21,12 @@ HEADERS += \
 	src/fileoperationresultcode.h \
 	src/cpanel.h \
 	src/diskenumerator/cdiskenumerator.h \
+	src/displayformatter/cdisplayformatter.h \
+	src/uithreaddispatcher/cuithreaddispatcher.h \
+	src/taskscheduler/ctaskscheduler.h \
+	src/listingcache/clistingcache.h \
+	src/startuptrace/cstartuptrace.h \
+	src/settingsstore/csettingsstore.h \
 	src/iconprovider/ciconprovider.h \
 	src/fileoperations/operationcodes.h \
 	src/fileoperations/coperationperformer.h \
@@ -37,6 +43,12 @@ SOURCES += \
 	src/ccontroller.cpp \
 	src/cpanel.cpp \
 	src/diskenumerator/cdiskenumerator.cpp \
+	src/displayformatter/cdisplayformatter.cpp \
+	src/uithreaddispatcher/cuithreaddispatcher.cpp \
+	src/taskscheduler/ctaskscheduler.cpp \
+	src/listingcache/clistingcache.cpp \
+	src/startuptrace/cstartuptrace.cpp \
+	src/settingsstore/csettingsstore.cpp \
 	src/iconprovider/ciconprovider.cpp \
 	src/fileoperations/coperationperformer.cpp \
 	src/shell/cshell.cpp \
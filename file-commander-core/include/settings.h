@@ -33,9 +33,12 @@
 #define KEY_INTERFACE_RESPECT_LAST_CURSOR_POS   "Interface/Selection/RespectLastCursorPosition"
 #define KEY_INTERFACE_NUMBERS_AFFTER_LETTERS    "Interface/Sorting/NumbersAfterLetters"
 #define KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS "Interface/View/ShowSpecialFolderIcons"
+#define KEY_INTERFACE_PREFETCH_FOLDER_UNDER_CURSOR "Interface/Performance/PrefetchFolderUnderCursor"
 
 // Operations
 #define KEY_OPERATIONS_ASK_FOR_COPY_MOVE_CONFIRMATION "Operations/CopyMove/AskForConfirmation"
+#define KEY_OPERATIONS_PRESERVE_HARDLINKS "Operations/CopyMove/PreserveHardlinks"
+#define KEY_OPERATIONS_OVERWRITE_CHANGED_BLOCKS_ONLY "Operations/CopyMove/OverwriteChangedBlocksOnly"
 
 // Editing
 #define KEY_EDITOR_PATH "Interface/Sorting/NumbersAfterLetters"
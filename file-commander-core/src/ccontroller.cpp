@@ -1,10 +1,11 @@
 #include "ccontroller.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 #include "settings.h"
 #include "shell/cshell.h"
 #include "pluginengine/cpluginengine.h"
 #include "filesystemhelperfunctions.h"
 #include "iconprovider/ciconprovider.h"
+#include "startuptrace/cstartuptrace.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QDesktopServices>
@@ -16,22 +17,39 @@ RESTORE_COMPILER_WARNINGS
 
 CController* CController::_instance = nullptr;
 
-CController::CController() : _leftPanel(LeftPanel), _rightPanel(RightPanel), _workerThread(4, "CController worker thread")
+CController::CController() : _leftPanel(LeftPanel), _rightPanel(RightPanel)
 {
 	assert_r(_instance == nullptr); // Only makes sense to create one controller
 	_instance = this;
 
+	// The disk enumerator thread delivers the disk list as soon as it has it
 	_diskEnumerator.addObserver(this);
-	CPluginEngine::get().loadPlugins();
 
 	_leftPanel.addPanelContentsChangedListener(&CPluginEngine::get());
 	_rightPanel.addPanelContentsChangedListener(&CPluginEngine::get());
 
-	// Manual update for the CPanels to get the disk list
-	_diskEnumerator.updateSynchronously();
+	_leftPanel.addPanelContentsChangedListener(this);
+	_rightPanel.addPanelContentsChangedListener(this);
+}
+
+// Restores the panels and loads the plugins. Everything is queued on the UI thread, so calling this right after showing the main window lets the window paint first.
+void CController::initialize()
+{
+	_uiQueue.enqueue([this]() {
+		// Both listings are enumerated on the task scheduler, concurrently
+		_leftPanel.restoreFromSettings();
+		_rightPanel.restoreFromSettings();
+		CStartupTrace::milestone("panels restored, listing");
+	});
 
-	_leftPanel.restoreFromSettings();
-	_rightPanel.restoreFromSettings();
+	_uiQueue.enqueue([this]() {
+		CPluginEngine::get().loadPlugins();
+		CStartupTrace::milestone("plugins loaded");
+
+		// The plugins have missed the notifications that may have already been delivered
+		CPluginEngine::get().panelContentsChanged(LeftPanel, refreshCauseOther);
+		CPluginEngine::get().panelContentsChanged(RightPanel, refreshCauseOther);
+	}, CUiThreadDispatcher::NoTag, CUiThreadDispatcher::LowPriority);
 }
 
 CController& CController::get()
@@ -54,14 +72,6 @@ void CController::setDisksChangedListener(CController::IDiskListObserver *listen
 	disksChanged();
 }
 
-void CController::uiThreadTimerTick()
-{
-	_leftPanel.uiThreadTimerTick();
-	_rightPanel.uiThreadTimerTick();
-
-	_uiQueue.exec(CExecutionQueue::execFirst);
-}
-
 // Updates the list of files in the current directory this panel is viewing, and send the new state to UI
 void CController::refreshPanelContents(Panel p)
 {
@@ -107,16 +117,16 @@ FileOperationResultCode CController::itemActivated(qulonglong itemHash, Panel p)
 bool CController::switchToDisk(Panel p, size_t index)
 {
 	assert_r(index < _diskEnumerator.drives().size());
-	const QString drivePath = _diskEnumerator.drives().at(index).storageInfo.rootPath();
+	const QString drivePath = _diskEnumerator.drives().at(index).rootPath;
 
 	FileOperationResultCode result = rcDirNotAccessible;
-	if (drivePath == _diskEnumerator.drives().at(currentDiskIndex(otherPanelPosition(p))).storageInfo.rootPath())
+	if (drivePath == _diskEnumerator.drives().at(currentDiskIndex(otherPanelPosition(p))).rootPath)
 	{
 		result = setPath(p, otherPanel(p).currentDirPathNative(), refreshCauseOther);
 	}
 	else
 	{
-		const QString lastPathForDrive = CSettings().value(p == LeftPanel ? KEY_LAST_PATH_FOR_DRIVE_L.arg(drivePath.toHtmlEscaped()) : KEY_LAST_PATH_FOR_DRIVE_R.arg(drivePath.toHtmlEscaped()), drivePath).toString();
+		const QString lastPathForDrive = CSettingsStore::get().value(p == LeftPanel ? KEY_LAST_PATH_FOR_DRIVE_L.arg(drivePath.toHtmlEscaped()) : KEY_LAST_PATH_FOR_DRIVE_R.arg(drivePath.toHtmlEscaped()), drivePath).toString();
 		result = setPath(p, lastPathForDrive, refreshCauseOther);
 	}
 
@@ -141,36 +151,25 @@ void CController::activePanelChanged(Panel p)
 void CController::navigateUp(Panel p)
 {
 	panel(p).navigateUp();
-	disksChanged(); // To select a proper drive button
-	saveDirectoryForCurrentDisk(p);
 }
 
 // Go to the previous location from history, if any
 void CController::navigateBack(Panel p)
 {
 	panel(p).navigateBack();
-	saveDirectoryForCurrentDisk(p);
-	disksChanged(); // To select a proper drive button
 }
 
 // Go to the next location from history, if any
 void CController::navigateForward(Panel p)
 {
 	panel(p).navigateForward();
-	saveDirectoryForCurrentDisk(p);
-	disksChanged(); // To select a proper drive button
 }
 
 // Sets the specified path, if possible. Otherwise reverts to the previously set path
 FileOperationResultCode CController::setPath(Panel p, const QString &path, FileListRefreshCause operation)
 {
-	CPanel& targetPanel = panel(p);
-	const QString prevPath = targetPanel.currentDirPathNative();
-	const FileOperationResultCode result = targetPanel.setPath(path, operation);
-
-	saveDirectoryForCurrentDisk(p);
-	disksChanged(); // To select a proper drive button
-	return result;
+	// The navigation completes asynchronously, see panelContentsChanged()
+	return panel(p).setPath(path, operation);
 }
 
 bool CController::createFolder(const QString &parentFolder, const QString &name)
@@ -243,6 +242,12 @@ void CController::displayDirSize(Panel p, qulonglong dirHash)
 	panel(p).displayDirSize(dirHash);
 }
 
+// Reads the specified subfolder in advance so that navigating into it is instant (if enabled in the settings)
+void CController::prefetchFolder(Panel p, qulonglong dirHash)
+{
+	panel(p).prefetchFolder(dirHash);
+}
+
 void CController::showAllFilesFromCurrentFolderAndBelow(Panel p)
 {
 	panel(p).showAllFilesFromCurrentFolderAndBelow();
@@ -362,13 +367,22 @@ CFileSystemObject CController::itemByHash( Panel p, qulonglong hash ) const
 std::vector<CFileSystemObject> CController::items(Panel p, const std::vector<qulonglong>& hashes) const
 {
 	std::vector<CFileSystemObject> objects;
-	std::for_each(hashes.begin(), hashes.end(), [&objects, p, this] (qulonglong hash) {objects.push_back(itemByHash(p, hash));});
+	objects.reserve(hashes.size());
+	const auto snapshot = panel(p).snapshot();
+	for (const qulonglong hash: hashes)
+	{
+		const CFileSystemObject* item = snapshot->item(hash);
+		objects.push_back(item ? *item : CFileSystemObject());
+	}
+
 	return objects;
 }
 
 QString CController::itemPath(Panel p, qulonglong hash) const
 {
-	return panel(p).itemByHash(hash).properties().fullPath;
+	const auto snapshot = panel(p).snapshot();
+	const CFileSystemObject* item = snapshot->item(hash);
+	return item ? item->properties().fullPath : QString();
 }
 
 CDiskEnumerator& CController::diskEnumerator()
@@ -384,9 +398,10 @@ QString CController::diskPath(size_t index) const
 size_t CController::currentDiskIndex(Panel p) const
 {
 	const auto& drives = _diskEnumerator.drives();
+	const CFileSystemObject currentDir(panel(p).currentDirPathNative());
 	for (size_t i = 0; i < drives.size(); ++i)
 	{
-		if (CFileSystemObject(panel(p).currentDirPathNative()).isChildOf(drives[i].fileSystemObject))
+		if (currentDir.isChildOf(drives[i].fileSystemObject))
 			return i;
 	}
 
@@ -407,6 +422,8 @@ qulonglong CController::currentItemInFolder(Panel p, const QString &dir) const
 void CController::disksChanged()
 {
 	const auto& drives = _diskEnumerator.drives();
+	if (!drives.empty())
+		CStartupTrace::milestone("disk list available");
 
 	_rightPanel.disksChanged(drives);
 	_leftPanel.disksChanged(drives);
@@ -418,11 +435,35 @@ void CController::disksChanged()
 	}
 }
 
+// A navigation has completed, or the contents of the current folder have changed
+void CController::panelContentsChanged(Panel p, FileListRefreshCause /*operation*/)
+{
+	// The free space is not polled, it's re-read when the contents of a panel change (which is also what a file operation causes)
+	_diskEnumerator.requestFreeSpaceUpdate(currentDiskIndex(p));
+
+	const QString currentPath = panel(p).currentDirPathNative();
+	QString& lastKnownPath = p == LeftPanel ? _leftPanelLastKnownPath : _rightPanelLastKnownPath;
+	if (currentPath == lastKnownPath)
+		return;
+
+	lastKnownPath = currentPath;
+	saveDirectoryForCurrentDisk(p);
+	disksChanged(); // To select a proper drive button
+}
+
+void CController::itemDiscoveryInProgress(Panel /*p*/, qulonglong /*itemHash*/, size_t /*progress*/, const QString& /*currentDir*/)
+{
+}
+
 void CController::saveDirectoryForCurrentDisk(Panel p)
 {
+	// The disk list arrives asynchronously, it may not be there yet right after the startup
+	if (_diskEnumerator.drives().empty())
+		return;
+
 	assert_and_return_r(currentDiskIndex(p) < _diskEnumerator.drives().size(), );
 
-	const QString drivePath = _diskEnumerator.drives().at(currentDiskIndex(p)).storageInfo.rootPath();
+	const QString drivePath = _diskEnumerator.drives().at(currentDiskIndex(p)).rootPath;
 	const QString path = panel(p).currentDirPathNative();
-	CSettings().setValue(p == LeftPanel ? KEY_LAST_PATH_FOR_DRIVE_L.arg(drivePath.toHtmlEscaped()) : KEY_LAST_PATH_FOR_DRIVE_R.arg(drivePath.toHtmlEscaped()), path);
+	CSettingsStore::get().setValue(p == LeftPanel ? KEY_LAST_PATH_FOR_DRIVE_L.arg(drivePath.toHtmlEscaped()) : KEY_LAST_PATH_FOR_DRIVE_R.arg(drivePath.toHtmlEscaped()), path);
 }
@@ -7,7 +7,7 @@
 #include "plugininterface/cpluginproxy.h"
 #include "favoritelocationslist/cfavoritelocations.h"
 
-class CController : private CDiskEnumerator::IDiskListObserver
+class CController : private CDiskEnumerator::IDiskListObserver, private PanelContentsChangedListener
 {
 public:
 	// Disk list observer interface
@@ -21,12 +21,13 @@ public:
 	CController();
 	static CController& get();
 
+	// Restores the panels and loads the plugins. Everything is queued on the UI thread, so calling this right after showing the main window lets the window paint first.
+	void initialize();
+
 	void setPanelContentsChangedListener(Panel p, PanelContentsChangedListener * listener);
 	void setDisksChangedListener(IDiskListObserver * listener);
 
 // Notifications from UI
-	void uiThreadTimerTick();
-
 	// Updates the list of files in the current directory this panel is viewing, and send the new state to UI
 	void refreshPanelContents(Panel p);
 	// Creates a new tab for the specified panel, returns tab ID
@@ -61,6 +62,8 @@ public:
 	FilesystemObjectsStatistics calculateStatistics(Panel p, const std::vector<qulonglong> & hashes);
 	// Calculates directory size, stores it in the corresponding CFileSystemObject and sends data change notification
 	void displayDirSize(Panel p, qulonglong dirHash);
+	// Reads the specified subfolder in advance so that navigating into it is instant (if enabled in the settings)
+	void prefetchFolder(Panel p, qulonglong dirHash);
 	// Flattens the current directory and displays all its child files on one level
 	void showAllFilesFromCurrentFolderAndBelow(Panel p);
 	// Indicates that we need to move cursor (e. g. a folder is being renamed and we want to keep the cursor on it)
@@ -68,14 +71,15 @@ public:
 	void setCursorPositionForCurrentFolder(qulonglong newCurrentItemHash);
 
 // Threading
-	inline void execOnWorkerThread(const std::function<void()>& task)
+	inline void execOnWorkerThread(const std::function<void()>& task, CTaskScheduler::Lane lane = CTaskScheduler::InteractiveLane)
 	{
-		_workerThread.enqueue(task);
+		CTaskScheduler::get().enqueue(task, lane);
 	}
 
-	inline void execOnUiThread(const std::function<void ()>& task)
+	// A task with a tag replaces the pending task with the same tag, if any
+	inline void execOnUiThread(const std::function<void ()>& task, int tag = CUiThreadDispatcher::NoTag, CUiThreadDispatcher::Priority priority = CUiThreadDispatcher::NormalPriority)
 	{
-		_uiQueue.enqueue(task);
+		_uiQueue.enqueue(task, tag, priority);
 	}
 
 // Getters
@@ -107,6 +111,10 @@ public:
 private:
 	void disksChanged() override;
 
+	// CPanel observers
+	void panelContentsChanged(Panel p, FileListRefreshCause operation) override;
+	void itemDiscoveryInProgress(Panel p, qulonglong itemHash, size_t progress, const QString& currentDir) override;
+
 	void saveDirectoryForCurrentDisk(Panel p);
 
 private:
@@ -117,9 +125,9 @@ private:
 	CDiskEnumerator      _diskEnumerator;
 	std::vector<IDiskListObserver*> _disksChangedListeners;
 	Panel                _activePanel;
+	QString              _leftPanelLastKnownPath, _rightPanelLastKnownPath; // For noticing when a navigation has completed
 
-	CWorkerThreadPool _workerThread; // The thread used to execute tasks out of the UI thread
-	CExecutionQueue   _uiQueue;      // The queue for actions that must be executed on the UI thread
+	CUiThreadDispatcher _uiQueue;      // The queue for actions that must be executed on the UI thread
 };
 
 #endif // CCONTROLLER_H
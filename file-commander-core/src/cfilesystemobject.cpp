@@ -86,6 +86,8 @@ void CFileSystemObject::setPath(const QString& path)
 	_thisFile.reset();
 	_destFile.reset();
 	_pos = 0;
+	_bytesWritten = 0;
+	_onlyWriteChangedBlocks = false;
 
 	_fileInfo.setFile(path);
 
@@ -181,6 +183,7 @@ QString CFileSystemObject::parentDirPath() const
 	return _properties.parentFolder;
 }
 
+// UI thread only
 const QIcon& CFileSystemObject::icon() const
 {
 	return CIconProvider::iconForFilesystemObject(*this);
@@ -337,7 +340,7 @@ FileOperationResultCode CFileSystemObject::moveAtomically(const QString& locatio
 // Non-blocking file copy API
 
 // Requests copying the next (or the first if copyOperationInProgress() returns false) chunk of the file.
-FileOperationResultCode CFileSystemObject::copyChunk(uint64_t chunkSize, const QString& destFolder, const QString& newName)
+FileOperationResultCode CFileSystemObject::copyChunk(uint64_t chunkSize, const QString& destFolder, const QString& newName, bool onlyWriteChangedBlocks)
 {
 	assert_r(bool(_thisFile) == bool(_destFile));
 	assert_r(isFile());
@@ -346,10 +349,13 @@ FileOperationResultCode CFileSystemObject::copyChunk(uint64_t chunkSize, const Q
 	if (!copyOperationInProgress())
 	{
 		_pos = 0;
+		_bytesWritten = 0;
 
 		// Creating files
 		_thisFile = std::make_shared<QFile>(fullAbsolutePath());
 		_destFile = std::make_shared<QFile>(destFolder + (newName.isEmpty() ? _properties.fullName : newName));
+		// Comparing only makes sense if there's something to compare with
+		_onlyWriteChangedBlocks = onlyWriteChangedBlocks && _destFile->exists();
 
 		// Initializing - opening files
 		if (!_thisFile->open(QFile::ReadOnly))
@@ -395,7 +401,26 @@ FileOperationResultCode CFileSystemObject::copyChunk(uint64_t chunkSize, const Q
 			return rcFail;
 		}
 
-		memcpy(dest, src, actualChunkSize);
+		if (_onlyWriteChangedBlocks)
+		{
+			// Untouched pages of the mapping are not written back, so unchanged blocks cost a read but no write
+			const uint64_t blockSize = 64 * 1024;
+			for (uint64_t offset = 0; offset < actualChunkSize; offset += blockSize)
+			{
+				const size_t blockLength = (size_t)std::min(blockSize, actualChunkSize - offset);
+				if (memcmp(dest + offset, src + offset, blockLength) != 0)
+				{
+					memcpy(dest + offset, src + offset, blockLength);
+					_bytesWritten += blockLength;
+				}
+			}
+		}
+		else
+		{
+			memcpy(dest, src, actualChunkSize);
+			_bytesWritten += actualChunkSize;
+		}
+
 		_pos += actualChunkSize;
 
 		_thisFile->unmap(src);
@@ -430,6 +455,12 @@ uint64_t CFileSystemObject::bytesCopied() const
 	return _pos;
 }
 
+// The number of bytes actually written to the destination file, which is less than bytesCopied() if unchanged blocks were skipped
+uint64_t CFileSystemObject::bytesWritten() const
+{
+	return _bytesWritten;
+}
+
 FileOperationResultCode CFileSystemObject::cancelCopy()
 {
 	if (copyOperationInProgress())
@@ -99,10 +99,13 @@ public:
 
 // Non-blocking file copy API
 	// Requests copying the next (or the first if copyOperationInProgress() returns false) chunk of the file.
-	FileOperationResultCode copyChunk(uint64_t chunkSize, const QString& destFolder, const QString& newName = QString());
+	// If onlyWriteChangedBlocks is set, existing destination data is compared to the source block by block and only the blocks that differ are written.
+	FileOperationResultCode copyChunk(uint64_t chunkSize, const QString& destFolder, const QString& newName = QString(), bool onlyWriteChangedBlocks = false);
 	FileOperationResultCode moveChunk(uint64_t chunkSize, const QString& destFolder, const QString& newName = QString());
 	bool copyOperationInProgress() const;
 	uint64_t bytesCopied() const;
+	// The number of bytes actually written to the destination file, which is less than bytesCopied() if unchanged blocks were skipped
+	uint64_t bytesWritten() const;
 	FileOperationResultCode cancelCopy();
 
 	bool                    makeWritable(bool writeable = true);
@@ -122,6 +125,8 @@ private:
 	std::shared_ptr<QFile>      _thisFile;
 	std::shared_ptr<QFile>      _destFile;
 	uint64_t                    _pos = 0;
+	uint64_t                    _bytesWritten = 0;
+	bool                        _onlyWriteChangedBlocks = false;
 };
 
 #endif // CFILESYSTEMOBJECT_H
@@ -1,5 +1,5 @@
 #include "cpanel.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 #include "settings.h"
 #include "filesystemhelperfunctions.h"
 #include "assert/advanced_assert.h"
@@ -10,18 +10,68 @@ DISABLE_COMPILER_WARNINGS
 #include <QVector>
 RESTORE_COMPILER_WARNINGS
 
-#include <time.h>
+#include <chrono>
 #include <limits>
+#include <time.h>
+
+static const int64_t progressNotificationsPerSecond = 10;
+
+static int64_t steadyClockMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CFileListSnapshot::CFileListSnapshot(Items&& items) : _items(std::move(items))
+{
+	for (const auto& item: _items)
+	{
+		const CFileSystemObject& object = item.second;
+		if (object.isFile())
+			++_statistics.files;
+		else if (object.isDir())
+			++_statistics.folders;
+		_statistics.occupiedSpace += object.size();
+	}
+}
+
+const CFileListSnapshot::Items& CFileListSnapshot::items() const
+{
+	return _items;
+}
+
+// Returns the item with the specified hash, or nullptr if there's no such item in this snapshot
+const CFileSystemObject* CFileListSnapshot::item(qulonglong hash) const
+{
+	const auto it = _items.find(hash);
+	return it != _items.end() ? &it->second : nullptr;
+}
+
+// The number of files and folders in the listing and their total size
+const FilesystemObjectsStatistics& CFileListSnapshot::statistics() const
+{
+	return _statistics;
+}
 
 CPanel::CPanel(Panel position) :
+	_snapshot(std::make_shared<CFileListSnapshot>()),
 	_panelPosition(position),
-	_workerThreadPool(4, "File list refresh thread")
+	_listingStrand(CTaskScheduler::InteractiveLane),
+	_statisticsStrand(CTaskScheduler::BackgroundLane)
 {
+	_prefetchEnabled = CSettingsStore::get().valueAs<bool>(KEY_INTERFACE_PREFETCH_FOLDER_UNDER_CURSOR, false);
+	_prefetchSettingSubscription = CSettingsStore::get().subscribe(KEY_INTERFACE_PREFETCH_FOLDER_UNDER_CURSOR, [this](const QString& /*key*/, const QVariant& value) {
+		_prefetchEnabled = value.toBool();
+	});
+}
+
+CPanel::~CPanel()
+{
+	CSettingsStore::get().unsubscribe(_prefetchSettingSubscription);
 }
 
 void CPanel::restoreFromSettings()
 {
-	CSettings s;
+	CSettingsStore& s = CSettingsStore::get();
 	const QStringList historyList(s.value(_panelPosition == RightPanel ? KEY_HISTORY_R : KEY_HISTORY_L).toStringList());
 	_history.addLatest(historyList.toVector().toStdVector());
 	setPath(s.value(_panelPosition == LeftPanel ? KEY_LPANEL_PATH : KEY_RPANEL_PATH, QDir::root().absolutePath()).toString(), refreshCauseOther);
@@ -39,78 +89,110 @@ FileOperationResultCode CPanel::setPath(const QString &path, FileListRefreshCaus
 
 	_currentDisplayMode = NormalMode;
 
+	// Only a cheap check here so that the caller can report the requested folder as inaccessible. Which folder is actually displayed is decided in the background, along with reading it.
+	// A disk that's not responding is not touched at all, even a stat() would block the UI thread.
+	bool requestedDirAccessible = false;
 	std::unique_lock<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
-
-	const QString oldPath = _currentDirObject.fullAbsolutePath();
-	const auto pathGraph = CFileSystemObject::pathHierarchy(posixPath);
-	bool pathSet = false;
-	for (const auto& candidatePath: pathGraph)
+	const bool requestedStorageReady = storageIsReady(_disks, posixPath);
+	locker.unlock();
+	if (requestedStorageReady)
 	{
-		if (pathIsAccessible(candidatePath))
-		{
-			_currentDirObject.setPath(candidatePath);
-			pathSet = true;
-			break;
-		}
+		const CFileSystemObject requestedDir(posixPath);
+		requestedDirAccessible = requestedDir.exists() && requestedDir.isReadable();
 	}
 
-	if (!pathSet)
+	// Remembering the item the cursor was on if we're going into one of the subfolders
+	for (const auto& item : snapshot()->items())
 	{
-		if (pathIsAccessible(oldPath))
-			_currentDirObject.setPath(oldPath);
-		else
+		const QString itemPath = toPosixSeparators(item.second.fullAbsolutePath());
+		if (posixPath == itemPath && toPosixSeparators(item.second.parentDirPath()) != itemPath)
 		{
-			QString pathToSet;
-			for (auto it = history().rbegin() + (history().size() - 1 - history().currentIndex()); it != history().rend(); ++it)
-			{
-				if (pathIsAccessible(*it))
-				{
-					pathToSet = *it;
-					break;
-				}
-			}
-
-			if (pathToSet.isEmpty())
-				pathToSet = QDir::rootPath();
-			_currentDirObject.setPath(pathToSet);
+			setCurrentItemForFolder(item.second.parentDirPath(), item.second.properties().hash);
+			break;
 		}
 	}
 
-	const QString newPath = _currentDirObject.fullAbsolutePath();
+	// The requested folder or its closest accessible parent, then the places we've come from, and the root as the last resort
+	std::vector<QString> candidatePaths = CFileSystemObject::pathHierarchy(posixPath);
+	const size_t numRequestedPathCandidates = candidatePaths.size();
+
+	locker.lock();
+	// Any refresh or navigation still queued or in progress is for the location we're leaving
+	const uint64_t generation = ++_listingGeneration;
 
-	// History management
-	if (toPosixSeparators(_history.currentItem()) != toPosixSeparators(newPath))
+	const QString oldPath = _currentDirObject.fullAbsolutePath();
+	candidatePaths.push_back(oldPath);
+	if (!_history.empty())
 	{
-		_history.addLatest(newPath);
-		CSettings().setValue(_panelPosition == RightPanel ? KEY_HISTORY_R : KEY_HISTORY_L, QVariant(QStringList::fromVector(QVector<QString>::fromStdVector(_history.list()))));
+		for (auto it = history().rbegin() + (history().size() - 1 - history().currentIndex()); it != history().rend(); ++it)
+			candidatePaths.push_back(*it);
 	}
+	candidatePaths.push_back(QDir::rootPath());
 
-	CSettings().setValue(_panelPosition == LeftPanel ? KEY_LPANEL_PATH : KEY_RPANEL_PATH, newPath);
+	if (toPosixSeparators(oldPath) != toPosixSeparators(posixPath))
+	{
+		// The sizes of the folders we're leaving are of no interest any more
+		_statisticsCancellation.cancel();
+		_statisticsCancellation = CCancellationToken();
+		_prefetchCancellation.cancel();
+		_prefetchCancellation = CCancellationToken();
+	}
 
-	_watcher = std::make_shared<QFileSystemWatcher>();
+	const std::vector<CDiskEnumerator::DiskInfo> disks = _disks;
+	locker.unlock();
 
-	if (_watcher->addPath(newPath) == false)
-		qDebug() << __FUNCTION__ << "Error adding path" << newPath << "to QFileSystemWatcher";
+	const auto candidates = std::make_shared<const std::vector<QString>>(std::move(candidatePaths));
+	_listingStrand.enqueue([this, candidates, numRequestedPathCandidates, disks, operation, generation]() {
+		navigateToFirstAccessibleCandidate(candidates, 0, numRequestedPathCandidates, disks, operation, generation);
+	});
 
-	connect(_watcher.get(), &QFileSystemWatcher::directoryChanged, this, &CPanel::contentsChanged);
-	connect(_watcher.get(), &QFileSystemWatcher::fileChanged, this, &CPanel::contentsChanged);
-	connect(_watcher.get(), &QFileSystemWatcher::objectNameChanged, this, &CPanel::contentsChanged);
+	return requestedDirAccessible ? rcOk : rcDirNotAccessible;
+}
 
-	// Finding hash of an item corresponding to path
-	for (const auto& item : _items)
+// Makes the first accessible one of the candidate folders, starting from the specified one, current and lists it; runs on _listingStrand
+void CPanel::navigateToFirstAccessibleCandidate(const std::shared_ptr<const std::vector<QString>>& candidatePaths, size_t firstCandidate, size_t numRequestedPathCandidates, const std::vector<CDiskEnumerator::DiskInfo>& disks, FileListRefreshCause operation, uint64_t generation)
+{
+	for (size_t i = firstCandidate; i < candidatePaths->size(); ++i)
 	{
-		const QString itemPath = toPosixSeparators(item.second.fullAbsolutePath());
-		if (posixPath == itemPath && toPosixSeparators(item.second.parentDirPath()) != itemPath)
+		if (listingGenerationIsStale(generation))
+			return;
+
+		// Checked before anything else: creating the object already accesses the disk, and that blocks if it's not responding
+		if (!storageIsReady(disks, (*candidatePaths)[i]))
+			continue;
+
+		const CFileSystemObject candidate((*candidatePaths)[i]);
+		if (!candidate.exists() || !candidate.isDir() || !candidate.isReadable())
+			continue;
+
+		// Falling back to a different location is not the navigation that was asked for
+		const FileListRefreshCause refreshCause = i < numRequestedPathCandidates ? operation : refreshCauseOther;
+
+		// A folder that has been listed recently is known to be accessible, and the listing is displayed straight away
+		if (CListingCache::get().contains(candidate.fullAbsolutePath()))
 		{
-			setCurrentItemForFolder(item.second.parentDirPath(), item.second.properties().hash);
-			break;
+			if (!setCurrentDirObject(candidate, generation))
+				return;
+
+			listCurrentFolder(refreshCause, generation, 0);
+			return;
 		}
-	}
 
-	locker.unlock();
+		// Reading the folder is the accessibility check: a folder that can't be read has no entries at all, not even ".."
+		const uint64_t request = ++_listingRequestsMade;
+		readFolder(candidate, generation, 0, [=](const CListingCache::Listing& listing) {
+			if (listing->empty())
+			{
+				navigateToFirstAccessibleCandidate(candidatePaths, i + 1, numRequestedPathCandidates, disks, operation, generation);
+				return;
+			}
+
+			if (setCurrentDirObject(candidate, generation))
+				publishListing(listing, request, refreshCause, generation);
+		});
 
-	refreshFileList(pathSet ? operation : refreshCauseOther);
-	return pathSet ? rcOk : rcDirNotAccessible;
+		return;
+	}
 }
 
 // Navigates up the directory tree
@@ -157,7 +239,14 @@ void CPanel::showAllFilesFromCurrentFolderAndBelow()
 	_currentDisplayMode = AllObjectsMode;
 	_watcher.reset();
 
-	_workerThreadPool.enqueue([this]() {
+	std::unique_lock<std::recursive_mutex> generationLocker(_fileListAndCurrentDirMutex);
+	const uint64_t generation = ++_listingGeneration;
+	generationLocker.unlock();
+
+	_listingStrand.enqueue([this, generation]() {
+		if (listingGenerationIsStale(generation))
+			return;
+
 		std::unique_lock<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
 		const QString path = _currentDirObject.fullAbsolutePath();
 
@@ -165,21 +254,17 @@ void CPanel::showAllFilesFromCurrentFolderAndBelow()
 		auto items = recurseDirectoryItems(path, false);
 		locker.lock();
 
-		_items.clear();
-
-		const bool showHiddenFiles = CSettings().value(KEY_INTERFACE_SHOW_HIDDEN_FILES, true).toBool();
-		for (const auto& item : items)
-		{
-			if (item.exists() && (showHiddenFiles || !item.isHidden()))
-				_items[item.hash()] = item;
-		}
+		if (listingGenerationIsStale(generation))
+			return;
 
+		publishItems(filteredItems(items));
 		sendContentsChangedNotification(refreshCauseOther);
 	});
 }
 
 CFileSystemObject CPanel::currentDirObject() const
 {
+	std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
 	return _currentDirObject;
 }
 
@@ -222,72 +307,216 @@ qulonglong CPanel::currentItemForFolder(const QString &dir) const
 // Enumerates objects in the current directory
 void CPanel::refreshFileList(FileListRefreshCause operation)
 {
-	_workerThreadPool.enqueue([this, operation]() {
-		const time_t start = clock();
-		QFileInfoList list;
+	// Only a listing made after this moment reflects the current state of the folder, e. g. one made by the other panel in response to the same change
+	const int64_t acceptCachedListingsMadeAfter = CListingCache::now();
+	// Refreshes of the same location share the generation; the ones that are still pending when the user navigates elsewhere are dropped
+	const uint64_t generation = _listingGeneration;
+	_listingStrand.enqueue([this, operation, generation, acceptCachedListingsMadeAfter]() {
+		listCurrentFolder(operation, generation, acceptCachedListingsMadeAfter);
+	});
+}
 
+// Reads the current folder and publishes the listing; runs on _listingStrand. A cached listing of the folder made after the specified moment (CListingCache::now()) is used as is;
+// 0 means there's no such moment (a navigation), and then a cached listing is displayed while the folder is re-read.
+void CPanel::listCurrentFolder(FileListRefreshCause operation, uint64_t generation, int64_t acceptCachedListingsMadeAfter)
+{
+	if (listingGenerationIsStale(generation))
+		return;
+
+	// The folder is enumerated into a private buffer without holding the lock, the current listing stays available to the readers until the new one is published
+	const CFileSystemObject currentDir = currentDirObject();
+
+	FileListRefreshCause refreshCause = operation;
+	// An enumeration of the folder that is already in progress (e. g. by the other panel) is joined if it has started after this moment
+	int64_t acceptEnumerationsStartedAfter = acceptCachedListingsMadeAfter;
+	CListingCache::DirectoryStamp cachedStamp;
+	const CListingCache::Listing cachedListing = CListingCache::get().find(currentDir.fullAbsolutePath(), cachedStamp);
+	if (cachedListing && acceptCachedListingsMadeAfter > 0 && cachedStamp.takenAt >= acceptCachedListingsMadeAfter)
+	{
+		// A refresh: the listing has been read after the change that has caused the refresh (e. g. by the other panel), it's as current as a re-read would be
+		publishListing(cachedListing, ++_listingRequestsMade, operation, generation);
+		return;
+	}
+	else if (cachedListing && acceptCachedListingsMadeAfter == 0)
+	{
+		acceptEnumerationsStartedAfter = CListingCache::now();
+		// A navigation: the cached listing is displayed straight away unless its entries are known to have changed, and the folder is always re-read in the background,
+		// because the stamp can't tell about the changes made within its time resolution, nor about the files that have only changed their sizes or dates
+		if (CListingCache::directoryStamp(currentDir.fullAbsolutePath()) == cachedStamp)
 		{
-			std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
-
-			list = _currentDirObject.qDir().entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDot | QDir::Hidden | QDir::System);
-			qDebug() << "Getting file list for" << _currentDirObject.fullAbsolutePath() << "(" << list.size() << "items ) took" << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
+			publishListing(cachedListing, ++_listingRequestsMade, operation, generation);
+			// The navigation has already been displayed, the fresh listing only updates it
+			refreshCause = refreshCauseOther;
+		}
+		else
+			qDebug() << currentDir.fullAbsolutePath() << "has changed since it was cached, re-reading";
+	}
 
-			_items.clear();
+	const uint64_t request = ++_listingRequestsMade;
+	readFolder(currentDir, generation, acceptEnumerationsStartedAfter, [this, currentDir, request, refreshCause, operation, generation](const CListingCache::Listing& listing) {
+		if (!listing->empty())
+		{
+			publishListing(listing, request, refreshCause, generation);
+			return;
+		}
 
-			if (list.empty())
-			{
-				setPath(_currentDirObject.fullAbsolutePath(), operation); // setPath will itself find the closest best folder to set instead
-				return;
-			}
+		if (!listingGenerationIsStale(generation))
+		{
+			// The folder has become inaccessible, setPath will find the closest best folder to set instead
+			const QString path = currentDir.fullAbsolutePath();
+			_uiThreadQueue.enqueue([this, path, operation]() {
+				setPath(path, operation);
+			});
 		}
+	});
+}
 
-		const bool showHiddenFiles = CSettings().value(KEY_INTERFACE_SHOW_HIDDEN_FILES, true).toBool();
-		std::vector<CFileSystemObject> objectsList;
+// Reads the folder into a listing and caches it, or joins an enumeration of the folder already in progress that has started after the specified moment (CListingCache::now()); runs on _listingStrand.
+// The handler is called on _listingStrand with the listing, which has no objects if the folder can't be read; it's not called at all if the user has navigated elsewhere in the meantime.
+void CPanel::readFolder(const CFileSystemObject& dir, uint64_t generation, int64_t acceptEnumerationsStartedAfter, const CListingCache::ListingHandler& onListing)
+{
+	const QString dirPath = dir.fullAbsolutePath();
+	CListingCache::Listing listing;
+	const bool enumerated = CListingCache::get().enumerate(dirPath, acceptEnumerationsStartedAfter, [this, &dir, &dirPath, generation]() -> CListingCache::Listing {
+		const time_t start = clock();
+		const QFileInfoList list = dir.qDir().entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDot | QDir::Hidden | QDir::System);
+		qDebug() << "Getting file list for" << dirPath << "(" << list.size() << "items ) took" << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
+
+		// Immutable once complete, so it can be shared with the listing cache and the other panel
+		const auto objectsList = std::make_shared<std::vector<CFileSystemObject>>();
 
 		const size_t numItemsFound = list.size();
-		objectsList.reserve(numItemsFound);
+		objectsList->reserve(numItemsFound);
 
-		for (int i = 0; i < (int)numItemsFound; ++i)
-		{
-			objectsList.emplace_back(list[i]);
-			sendItemDiscoveryProgressNotification(_currentDirObject.hash(), 20 + 80 * i / numItemsFound, _currentDirObject.fullAbsolutePath());
-		}
+		// Listings that take less than a progress notification interval don't report any progress
+		_lastDiscoveryProgressTime = steadyClockMs();
 
+		const qulonglong dirHash = dir.hash();
+		static const int itemsBetweenGenerationChecks = 256;
+		for (int i = 0; i < (int)numItemsFound; ++i)
 		{
-			std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
-
-			for (const auto& object : objectsList)
+			if (i % itemsBetweenGenerationChecks == 0 && listingGenerationIsStale(generation))
 			{
-				if (object.exists() && (showHiddenFiles || !object.isHidden()))
-					_items[object.hash()] = object;
+				qDebug() << "Abandoning the stale listing of" << dirPath;
+				return CListingCache::Listing();
 			}
 
-			qDebug() << "Directory:" << _currentDirObject.fullAbsolutePath() << "(" << _items.size() << "items ) indexed in" << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
+			objectsList->emplace_back(list[i]);
+			sendItemDiscoveryProgressNotification(dirHash, 20 + 80 * i / numItemsFound, dirPath);
 		}
 
-		sendContentsChangedNotification(operation);
+		return CListingCache::Listing(objectsList);
+	}, listing, [this, dir, generation, acceptEnumerationsStartedAfter, onListing](const CListingCache::Listing& joinedListing) {
+		// The work continues on the strand rather than on the thread that has read the folder; an enumeration abandoned by its owner is retried
+		_listingStrand.enqueue([this, dir, generation, acceptEnumerationsStartedAfter, onListing, joinedListing]() {
+			if (listingGenerationIsStale(generation))
+				return;
+
+			if (joinedListing)
+				onListing(joinedListing);
+			else
+				readFolder(dir, generation, acceptEnumerationsStartedAfter, onListing);
+		});
 	});
+
+	// Otherwise the listing is delivered once the enumeration joined is done, the strand is free to do other work in the meantime
+	if (enumerated && listing)
+		onListing(listing);
+}
+
+// Publishes the listing, unless the user has navigated elsewhere or a listing requested later has been published in the meantime; runs on _listingStrand
+void CPanel::publishListing(const CListingCache::Listing& listing, uint64_t request, FileListRefreshCause operation, uint64_t generation)
+{
+	const time_t start = clock();
+	CFileListSnapshot::Items items = filteredItems(*listing);
+
+	{
+		std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
+		// Checked under the lock so that a navigation can't slip in between the check and publishing
+		if (listingGenerationIsStale(generation))
+			return;
+
+		// A refresh that has joined another panel's enumeration of the folder is delivered out of order, and may be older than what's on display
+		if (request < _lastPublishedListingRequest)
+			return;
+
+		_lastPublishedListingRequest = request;
+		publishItems(std::move(items));
+
+		qDebug() << "Directory:" << _currentDirObject.fullAbsolutePath() << "(" << snapshot()->items().size() << "items ) indexed in" << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
+	}
+
+	sendContentsChangedNotification(operation);
+}
+
+// Makes the folder found by a navigation current, unless the user has navigated elsewhere in the meantime; runs on _listingStrand.
+// The rest of the navigation (history, file system watcher) is queued to the UI thread ahead of the listing notification.
+bool CPanel::setCurrentDirObject(const CFileSystemObject& dirObject, uint64_t generation)
+{
+	{
+		std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
+		if (listingGenerationIsStale(generation))
+			return false;
+
+		_currentDirObject = dirObject;
+	}
+
+	const QString newPath = dirObject.fullAbsolutePath();
+	// Queued at the same priority as the listing notification that follows, so that the two are delivered in order
+	_uiThreadQueue.enqueue([this, newPath, generation]() {
+		if (listingGenerationIsStale(generation))
+			return;
+
+		// History management
+		if (toPosixSeparators(_history.currentItem()) != toPosixSeparators(newPath))
+		{
+			_history.addLatest(newPath);
+			CSettingsStore::get().setValue(_panelPosition == RightPanel ? KEY_HISTORY_R : KEY_HISTORY_L, QVariant(QStringList::fromVector(QVector<QString>::fromStdVector(_history.list()))));
+		}
+
+		CSettingsStore::get().setValue(_panelPosition == LeftPanel ? KEY_LPANEL_PATH : KEY_RPANEL_PATH, newPath);
+
+		_watcher = std::make_shared<QFileSystemWatcher>();
+
+		if (_watcher->addPath(newPath) == false)
+			qDebug() << __FUNCTION__ << "Error adding path" << newPath << "to QFileSystemWatcher";
+
+		connect(_watcher.get(), &QFileSystemWatcher::directoryChanged, this, &CPanel::contentsChanged);
+		connect(_watcher.get(), &QFileSystemWatcher::fileChanged, this, &CPanel::contentsChanged);
+		connect(_watcher.get(), &QFileSystemWatcher::objectNameChanged, this, &CPanel::contentsChanged);
+	}, CUiThreadDispatcher::NoTag, CUiThreadDispatcher::HighPriority);
+
+	return true;
 }
 
 // Returns the current list of objects on this panel
 std::map<qulonglong, CFileSystemObject> CPanel::list() const
 {
-	std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
-	return _items;
+	return snapshot()->items();
+}
+
+// Returns the current listing without copying it; doesn't lock, can be called from any thread
+std::shared_ptr<const CFileListSnapshot> CPanel::snapshot() const
+{
+	return std::atomic_load(&_snapshot);
+}
+
+// Returns the number of files and folders in the current list and their total size; computed once per listing
+FilesystemObjectsStatistics CPanel::listingStatistics() const
+{
+	return snapshot()->statistics();
 }
 
 bool CPanel::itemHashExists(const qulonglong hash) const
 {
-	std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
-	return _items.count(hash) > 0;
+	return snapshot()->item(hash) != nullptr;
 }
 
 CFileSystemObject CPanel::itemByHash(qulonglong hash) const
 {
-	std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
-
-	const auto it = _items.find(hash);
-	return it != _items.end() ? it->second : CFileSystemObject();
+	const auto currentSnapshot = snapshot();
+	const CFileSystemObject* item = currentSnapshot->item(hash);
+	return item ? *item : CFileSystemObject();
 }
 
 // Calculates total size for the specified objects
@@ -297,10 +526,16 @@ FilesystemObjectsStatistics CPanel::calculateStatistics(const std::vector<qulong
 		return FilesystemObjectsStatistics();
 
 	FilesystemObjectsStatistics stats;
+	_lastDiscoveryProgressTime = steadyClockMs(); // Quick calculations don't report any progress
 	const size_t numItems = hashes.size();
 	for(size_t i = 0; i < numItems; ++i)
 	{
-		const CFileSystemObject item = itemByHash(hashes[i]);
+		const auto currentSnapshot = snapshot();
+		const CFileSystemObject* itemPtr = currentSnapshot->item(hashes[i]);
+		if (!itemPtr)
+			continue;
+
+		const CFileSystemObject& item = *itemPtr;
 		if (item.isDir())
 		{
 			++stats.folders;
@@ -330,53 +565,170 @@ FilesystemObjectsStatistics CPanel::calculateStatistics(const std::vector<qulong
 // Calculates directory size, stores it in the corresponding CFileSystemObject and sends data change notification
 void CPanel::displayDirSize(qulonglong dirHash)
 {
-	_workerThreadPool.enqueue([this, dirHash] {
+	std::lock_guard<std::recursive_mutex> tokenLocker(_fileListAndCurrentDirMutex);
+	_statisticsStrand.enqueue([this, dirHash] {
 		std::unique_lock<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
 
-		auto it = _items.find(dirHash);
-		assert_and_return_r(it != _items.end(), );
+		const auto initialSnapshot = snapshot();
+		const CFileSystemObject* item = initialSnapshot->item(dirHash);
+		assert_and_return_r(item, );
 
-		if (it->second.isDir())
+		if (item->isDir())
 		{
 			locker.unlock(); // Without this .unlock() the UI thread will get blocked very easily
 			const FilesystemObjectsStatistics stats = calculateStatistics(std::vector<qulonglong>(1, dirHash));
 			locker.lock();
-			// Since we unlocked the mutex, the item we were working on may well be out of the _items list by now
+			// Since we unlocked the mutex, the item we were working on may well be out of the list by now
 			// So we find it again and see if it's still there
-			it = _items.find(dirHash);
-			if (it == _items.end())
+			const auto currentSnapshot = snapshot();
+			if (!currentSnapshot->item(dirHash))
 				return;
 
-			it->second.setDirSize(stats.occupiedSpace);
+			// Published snapshots are immutable, the updated item goes into a new one
+			CFileListSnapshot::Items items = currentSnapshot->items();
+			items[dirHash].setDirSize(stats.occupiedSpace);
+			publishItems(std::move(items));
 			sendContentsChangedNotification(refreshCauseOther);
 		}
-	});
+	}, _statisticsCancellation);
+}
+
+// Enumerates the specified subfolder in the background so that navigating into it is instant; does nothing unless enabled in the settings
+void CPanel::prefetchFolder(qulonglong dirHash)
+{
+	if (!_prefetchEnabled)
+		return;
+
+	const auto currentSnapshot = snapshot();
+	const CFileSystemObject* item = currentSnapshot->item(dirHash);
+	if (!item || !item->isDir() || item->isCdUp())
+		return;
+
+	const QString path = item->fullAbsolutePath();
+
+	std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
+	// Only the folder the cursor is on now is of interest
+	_prefetchCancellation.cancel();
+	_prefetchCancellation = CCancellationToken();
+
+	const CCancellationToken token = _prefetchCancellation;
+	CTaskScheduler::get().enqueue([path, token]() {
+		// Even the cache lookup may touch the file system, so it's not done on the UI thread
+		if (CListingCache::get().contains(path))
+			return;
+
+		// Navigating into the folder while it's being prefetched joins this enumeration instead of starting another one. If the folder is already being read, there's nothing to do.
+		CListingCache::Listing listing;
+		CListingCache::get().enumerate(path, 0, [&path, &token]() -> CListingCache::Listing {
+			const QFileInfoList list = QDir(path).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDot | QDir::Hidden | QDir::System);
+
+			auto objects = std::make_shared<std::vector<CFileSystemObject>>();
+			objects->reserve(list.size());
+			static const int itemsBetweenCancellationChecks = 256;
+			for (int i = 0; i < list.size(); ++i)
+			{
+				if (i % itemsBetweenCancellationChecks == 0 && token.cancelled())
+					return CListingCache::Listing();
+
+				objects->emplace_back(list[i]);
+			}
+
+			return token.cancelled() ? CListingCache::Listing() : CListingCache::Listing(objects);
+		}, listing, [](const CListingCache::Listing&) {});
+	}, CTaskScheduler::BackgroundLane, token);
+}
+
+// True if the user has navigated elsewhere since the listing of this generation was requested
+bool CPanel::listingGenerationIsStale(uint64_t generation) const
+{
+	return generation != _listingGeneration;
+}
+
+// Replaces the current listing; must be called with _fileListAndCurrentDirMutex locked
+void CPanel::publishItems(CFileListSnapshot::Items&& items)
+{
+	// Readers that still hold the previous snapshot keep using it until they let go
+	std::atomic_store(&_snapshot, std::shared_ptr<const CFileListSnapshot>(std::make_shared<CFileListSnapshot>(std::move(items))));
+}
+
+// Picks the objects to be displayed according to the current settings
+CFileListSnapshot::Items CPanel::filteredItems(const std::vector<CFileSystemObject>& objects)
+{
+	const bool showHiddenFiles = CSettingsStore::get().valueAs<bool>(KEY_INTERFACE_SHOW_HIDDEN_FILES, true);
+	CFileListSnapshot::Items items;
+	for (const auto& object : objects)
+	{
+		if (object.exists() && (showHiddenFiles || !object.isHidden()))
+			items[object.hash()] = object;
+	}
+
+	return items;
 }
 
 void CPanel::sendContentsChangedNotification(FileListRefreshCause operation) const
 {
+	++_contentsChangedNotificationsSent;
+
+	// The user is waiting for this, it goes ahead of progress updates and other routine notifications
 	_uiThreadQueue.enqueue([this, operation]() {
 		for (auto listener : _panelContentsChangedListeners)
 			listener->panelContentsChanged(_panelPosition, operation);
-	});
+	}, CUiThreadDispatcher::NoTag, CUiThreadDispatcher::HighPriority);
 }
 
-// progress > 100 means indefinite
+// progress > 100 means indefinite. Can be called as often as needed: the progress is sampled at most 10 times per second
 void CPanel::sendItemDiscoveryProgressNotification(qulonglong itemHash, size_t progress, const QString& currentDir) const
 {
-	_uiThreadQueue.enqueue([=]() {
+	const int64_t now = steadyClockMs();
+	int64_t lastNotificationTime = _lastDiscoveryProgressTime;
+	if (now - lastNotificationTime < 1000 / progressNotificationsPerSecond)
+		return;
+
+	// Another thread may have sampled the progress in the meantime
+	if (!_lastDiscoveryProgressTime.compare_exchange_strong(lastNotificationTime, now))
+		return;
+
+	{
+		std::lock_guard<std::mutex> locker(_discoveryProgressMutex);
+		_latestDiscoveryProgress.itemHash = itemHash;
+		_latestDiscoveryProgress.progress = progress;
+		_latestDiscoveryProgress.currentDir = currentDir;
+		_latestDiscoveryProgress.contentsChangedNotificationsSent = _contentsChangedNotificationsSent;
+	}
+
+	// If the UI thread hasn't picked up the previous value yet, it will get this one instead
+	if (_discoveryProgressNotificationPending.exchange(true))
+		return;
+
+	_uiThreadQueue.enqueue([this]() {
+		_discoveryProgressNotificationPending = false;
+
+		DiscoveryProgress latestProgress;
+		{
+			std::lock_guard<std::mutex> locker(_discoveryProgressMutex);
+			latestProgress = _latestDiscoveryProgress;
+		}
+
+		// The listing this progress was leading up to has overtaken it
+		if (latestProgress.contentsChangedNotificationsSent != _contentsChangedNotificationsSent)
+			return;
+
 		for (auto listener : _panelContentsChangedListeners)
-			listener->itemDiscoveryInProgress(_panelPosition, itemHash, progress, currentDir);
-	}, 1);
+			listener->itemDiscoveryInProgress(_panelPosition, latestProgress.itemHash, latestProgress.progress, latestProgress.currentDir);
+	}, CUiThreadDispatcher::NoTag, CUiThreadDispatcher::LowPriority);
 }
 
 void CPanel::disksChanged(const std::vector<CDiskEnumerator::DiskInfo>& disks)
 {
-	_disks = disks;
+	{
+		std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
+		_disks = disks;
+	}
 
 	// Handling an unplugged device
-	if (_currentDirObject.isValid() && !storageInfoForObject(_currentDirObject).isReady())
-		setPath(_currentDirObject.fullAbsolutePath(), refreshCauseOther);
+	const CFileSystemObject currentDir = currentDirObject();
+	if (currentDir.isValid() && !storageIsReady(disks, currentDir.fullAbsolutePath()))
+		setPath(currentDir.fullAbsolutePath(), refreshCauseOther);
 }
 
 // Settings have changed
@@ -384,11 +736,6 @@ void CPanel::settingsChanged()
 {
 }
 
-void CPanel::uiThreadTimerTick()
-{
-	_uiThreadQueue.exec();
-}
-
 void CPanel::contentsChanged(QString /*path*/)
 {
 	refreshFileList(refreshCauseOther);
@@ -400,16 +747,32 @@ void CPanel::addPanelContentsChangedListener(PanelContentsChangedListener *liste
 	_panelContentsChangedListeners.push_back(listener);
 }
 
-const QStorageInfo& CPanel::storageInfoForObject(const CFileSystemObject& object) const
+// False if the path is on a disk that is known and not ready (e. g. an empty drive) or not responding (e. g. a disconnected share)
+bool CPanel::storageIsReady(const std::vector<CDiskEnumerator::DiskInfo>& disks, const QString& path)
 {
-	static const QStorageInfo dummy;
+	// The disk is the one with the longest mount point the path is under. Unlike comparing the device IDs, this doesn't stat() anything, the disk may be the one that's not responding
+#ifdef _WIN32
+	const Qt::CaseSensitivity caseSensitivity = Qt::CaseInsensitive;
+#else
+	const Qt::CaseSensitivity caseSensitivity = Qt::CaseSensitive;
+#endif
+	const QString posixPath = QDir::cleanPath(toPosixSeparators(path));
+	const CDiskEnumerator::DiskInfo* storage = nullptr;
+	int storageRootPathLength = -1;
+	for (const CDiskEnumerator::DiskInfo& disk: disks)
+	{
+		const QString rootPath = QDir::cleanPath(toPosixSeparators(disk.rootPath));
+		if (rootPath.isEmpty() || rootPath.length() <= storageRootPathLength || !posixPath.startsWith(rootPath, caseSensitivity))
+			continue;
 
-	const auto storage = std::find_if(_disks.cbegin(), _disks.cend(), [&object](const CDiskEnumerator::DiskInfo& item) {return item.fileSystemObject.rootFileSystemId() == object.rootFileSystemId();});
-	return storage != _disks.cend() ? storage->storageInfo : dummy;
-}
+		// "/mnt/data" is not the mount point of "/mnt/database"
+		if (posixPath.length() != rootPath.length() && !rootPath.endsWith('/') && posixPath[rootPath.length()] != '/')
+			continue;
 
-bool CPanel::pathIsAccessible(const QString& path) const
-{
-	const CFileSystemObject pathObject(path);
-	return pathObject.exists() && storageInfoForObject(pathObject).isReady() && pathObject.isReadable() && !pathObject.qDir().entryList().isEmpty();
+		storage = &disk;
+		storageRootPathLength = rootPath.length();
+	}
+
+	// The disk list arrives asynchronously, a disk that's not on it (yet) is given the benefit of the doubt
+	return !storage || (storage->isReady && storage->isResponding);
 }
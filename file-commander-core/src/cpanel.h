@@ -4,9 +4,11 @@
 #include "cfilesystemobject.h"
 #include "diskenumerator/cdiskenumerator.h"
 #include "historylist/chistorylist.h"
-#include "threading/cworkerthread.h"
-#include "threading/cexecutionqueue.h"
+#include "listingcache/clistingcache.h"
+#include "taskscheduler/ctaskscheduler.h"
+#include "uithreaddispatcher/cuithreaddispatcher.h"
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -46,6 +48,26 @@ public:
 	uint64_t occupiedSpace;
 };
 
+// An immutable listing of a panel. A snapshot never changes after it's been published and stays valid for as long as it's referenced,
+// so its items can be accessed by reference from any thread without copying or locking
+class CFileListSnapshot
+{
+public:
+	typedef std::map<qulonglong, CFileSystemObject> Items;
+
+	explicit CFileListSnapshot(Items&& items = Items());
+
+	const Items& items() const;
+	// Returns the item with the specified hash, or nullptr if there's no such item in this snapshot
+	const CFileSystemObject* item(qulonglong hash) const;
+	// The number of files and folders in the listing and their total size
+	const FilesystemObjectsStatistics& statistics() const;
+
+private:
+	const Items                 _items;
+	FilesystemObjectsStatistics _statistics;
+};
+
 class QFileSystemWatcher;
 
 class CPanel : public QObject
@@ -56,8 +78,10 @@ public:
 	void addPanelContentsChangedListener(PanelContentsChangedListener * listener);
 
 	explicit CPanel(Panel position);
+	~CPanel();
 	void restoreFromSettings();
-	// Sets the current directory
+	// Sets the current directory. The folder is read in the background; if it's not accessible, the closest accessible one is displayed instead.
+	// Returns rcDirNotAccessible if the requested folder is known to be inaccessible right away.
 	FileOperationResultCode setPath(const QString& path, FileListRefreshCause operation);
 	// Navigates up the directory tree
 	void navigateUp();
@@ -83,6 +107,11 @@ public:
 	void refreshFileList(FileListRefreshCause operation);
 	// Returns the current list of objects on this panel
 	std::map<qulonglong, CFileSystemObject> list() const;
+	// Returns the current listing without copying it; doesn't lock, can be called from any thread
+	std::shared_ptr<const CFileListSnapshot> snapshot() const;
+
+	// Returns the number of files and folders in the current list and their total size; computed once per listing
+	FilesystemObjectsStatistics listingStatistics() const;
 
 	bool itemHashExists(const qulonglong hash) const;
 	CFileSystemObject itemByHash(qulonglong hash) const;
@@ -91,9 +120,11 @@ public:
 	FilesystemObjectsStatistics calculateStatistics(const std::vector<qulonglong> & hashes);
 	// Calculates directory size, stores it in the corresponding CFileSystemObject and sends data change notification
 	void displayDirSize(qulonglong dirHash);
+	// Enumerates the specified subfolder in the background into the listing cache so that navigating into it is instant; does nothing unless enabled in the settings
+	void prefetchFolder(qulonglong dirHash);
 
 	void sendContentsChangedNotification(FileListRefreshCause operation) const;
-	// progress > 100 means indefinite
+	// progress > 100 means indefinite. Can be called as often as needed: the progress is sampled at most 10 times per second
 	void sendItemDiscoveryProgressNotification(qulonglong itemHash, size_t progress, const QString& currentDir) const;
 
 	void disksChanged(const std::vector<CDiskEnumerator::DiskInfo>& disks);
@@ -101,17 +132,37 @@ public:
 	// Settings have changed
 	void settingsChanged();
 
-	void uiThreadTimerTick();
-
 private:
-	const QStorageInfo& storageInfoForObject(const CFileSystemObject& object) const;
-	bool pathIsAccessible(const QString& path) const;
+	// False if the path is on a disk that is known and not ready (e. g. an empty drive) or not responding (e. g. a disconnected share). Doesn't access the file system
+	static bool storageIsReady(const std::vector<CDiskEnumerator::DiskInfo>& disks, const QString& path);
 
 	void contentsChanged(QString path);
+	// Makes the first accessible one of the candidate folders, starting from the specified one, current and lists it; runs on _listingStrand
+	void navigateToFirstAccessibleCandidate(const std::shared_ptr<const std::vector<QString>>& candidatePaths, size_t firstCandidate, size_t numRequestedPathCandidates, const std::vector<CDiskEnumerator::DiskInfo>& disks, FileListRefreshCause operation, uint64_t generation);
+	// Reads the current folder and publishes the listing; runs on _listingStrand. A cached listing of the folder made after the specified moment (CListingCache::now()) is used as is;
+	// 0 means there's no such moment (a navigation), and then a cached listing is displayed while the folder is re-read.
+	void listCurrentFolder(FileListRefreshCause operation, uint64_t generation, int64_t acceptCachedListingsMadeAfter);
+	// Reads the folder into a listing and caches it, or joins an enumeration of the folder already in progress that has started after the specified moment (CListingCache::now()); runs on _listingStrand.
+	// The handler is called on _listingStrand with the listing, which has no objects if the folder can't be read; it's not called at all if the user has navigated elsewhere in the meantime.
+	void readFolder(const CFileSystemObject& dir, uint64_t generation, int64_t acceptEnumerationsStartedAfter, const CListingCache::ListingHandler& onListing);
+	// Publishes the listing, unless the user has navigated elsewhere or a listing requested later has been published in the meantime; runs on _listingStrand
+	void publishListing(const CListingCache::Listing& listing, uint64_t request, FileListRefreshCause operation, uint64_t generation);
+	// Makes the folder found by a navigation current, unless the user has navigated elsewhere in the meantime; runs on _listingStrand.
+	// The rest of the navigation (history, file system watcher) is queued to the UI thread ahead of the listing notification.
+	bool setCurrentDirObject(const CFileSystemObject& dirObject, uint64_t generation);
+	// True if the user has navigated elsewhere since the listing of this generation was requested
+	bool listingGenerationIsStale(uint64_t generation) const;
+	// Replaces the current listing; must be called with _fileListAndCurrentDirMutex locked
+	void publishItems(CFileListSnapshot::Items&& items);
+	// Picks the objects to be displayed according to the current settings
+	static CFileListSnapshot::Items filteredItems(const std::vector<CFileSystemObject>& objects);
 
 private:
 	CFileSystemObject                          _currentDirObject;
-	std::map<qulonglong, CFileSystemObject>    _items;
+	std::shared_ptr<const CFileListSnapshot>   _snapshot; // Only accessed with std::atomic_load / std::atomic_store
+	std::atomic<uint64_t>                      _listingGeneration {0}; // Incremented under _fileListAndCurrentDirMutex on every navigation
+	uint64_t                                   _listingRequestsMade = 0; // Only accessed on _listingStrand, numbers the listings in the order they're requested
+	uint64_t                                   _lastPublishedListingRequest = 0; // Only accessed on _listingStrand
 	CHistoryList<QString>                      _history;
 	std::map<QString, qulonglong /*hash*/>     _cursorPosForFolder;
 	std::shared_ptr<QFileSystemWatcher>        _watcher;
@@ -121,9 +172,31 @@ private:
 
 	std::vector<CDiskEnumerator::DiskInfo>     _disks;
 
-	CWorkerThreadPool                          _workerThreadPool;
-	mutable CExecutionQueue                    _uiThreadQueue;
+	mutable CUiThreadDispatcher                _uiThreadQueue;
+
+	// The latest discovery progress, waiting to be picked up by the UI thread
+	struct DiscoveryProgress
+	{
+		qulonglong itemHash = 0;
+		size_t     progress = 0;
+		QString    currentDir;
+		uint64_t   contentsChangedNotificationsSent = 0; // The count at the time this progress was sampled
+	};
+	mutable DiscoveryProgress                  _latestDiscoveryProgress;
+	mutable std::mutex                         _discoveryProgressMutex;
+	mutable std::atomic<int64_t>               _lastDiscoveryProgressTime {0}; // ms, steady clock
+	mutable std::atomic<bool>                  _discoveryProgressNotificationPending {false};
+	mutable std::atomic<uint64_t>              _contentsChangedNotificationsSent {0}; // Progress sampled before a listing notification is not displayed after it
 	mutable std::recursive_mutex               _fileListAndCurrentDirMutex;
+
+	std::atomic<bool>                          _prefetchEnabled {false}; // Kept up to date by the settings store
+	int                                        _prefetchSettingSubscription = -1;
+
+	// Declared last so that they are destroyed first: destroying a strand waits for its current task, which may still be using the members above
+	CCancellationToken                         _statisticsCancellation; // Cancelled when the panel leaves the folder
+	CCancellationToken                         _prefetchCancellation; // Cancelled when another folder is to be prefetched or the panel leaves the folder
+	CTaskStrand                                _listingStrand;    // Enumerating the current folder, one refresh at a time
+	CTaskStrand                                _statisticsStrand; // Folder size calculations
 };
 
 #endif // CPANEL_H
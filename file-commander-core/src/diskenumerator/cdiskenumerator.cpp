@@ -2,6 +2,53 @@
 #include "utils/utils.h"
 #include "assert/advanced_assert.h"
 
+DISABLE_COMPILER_WARNINGS
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QTimer>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Milliseconds on a monotonic clock
+static int64_t monotonicTimeMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CDiskEnumerator::DiskInfo::DiskInfo(const QStorageInfo& qStorageInfo) :
+	rootPath(qStorageInfo.rootPath()),
+	name(qStorageInfo.name()),
+	device(qStorageInfo.device()),
+	fileSystemType(qStorageInfo.fileSystemType()),
+	fileSystemObject(qStorageInfo.rootPath()),
+	isReady(qStorageInfo.isReady()),
+	freeSpaceQueried(true),
+	bytesTotal(qStorageInfo.bytesTotal()),
+	bytesFree(qStorageInfo.bytesFree()),
+	bytesAvailable(qStorageInfo.bytesAvailable())
+{
+}
+
+QString CDiskEnumerator::DiskInfo::displayName() const
+{
+	return name.isEmpty() ? rootPath : name;
+}
+
+bool CDiskEnumerator::DiskInfo::freeSpaceIsKnown() const
+{
+	return freeSpaceQueried && isReady && isResponding;
+}
+
 void CDiskEnumerator::addObserver(IDiskListObserver *observer)
 {
 	assert_r(std::find(_observers.begin(), _observers.end(), observer) == _observers.end());
@@ -24,31 +71,303 @@ void CDiskEnumerator::updateSynchronously()
 	enumerateDisks(false);
 }
 
-CDiskEnumerator::CDiskEnumerator() : _enumeratorThread(_updateInterval, "CDiskEnumerator thread")
+CDiskEnumerator::CDiskEnumerator() : _queryContext(std::make_shared<QueryContext>())
 {
-	// Setting up the timer to fetch the notifications from the queue and execute them on this thread
-	connect(&_timer, &QTimer::timeout, [this](){
-		_notificationsQueue.exec();
-	});
-	_timer.start(_updateInterval / 3);
+	_queryContext->enumerator = this;
+
+#ifdef __linux__
+	if (::pipe2(_wakeUpPipe, O_CLOEXEC) != 0)
+	{
+		qDebug() << "CDiskEnumerator: failed to create the wake-up pipe";
+		_wakeUpPipe[0] = _wakeUpPipe[1] = -1;
+	}
+#endif
 
 	// Starting the worker thread that actually enumerates the disks
-	_enumeratorThread.start([this](){
-		enumerateDisks(true);
+	_enumeratorThread = std::thread([this](){
+		enumeratorThreadFunc();
+	});
+}
+
+CDiskEnumerator::~CDiskEnumerator()
+{
+	{
+		std::lock_guard<std::mutex> locker(_queryContext->mutex);
+		_queryContext->enumerator = nullptr;
+	}
+
+	{
+		std::lock_guard<std::mutex> locker(_terminationMutex);
+		_terminate = true;
+	}
+	_terminationCondition.notify_all();
+
+#ifdef __linux__
+	if (_wakeUpPipe[1] >= 0)
+	{
+		const char byte = 0;
+		while (::write(_wakeUpPipe[1], &byte, 1) < 0 && errno == EINTR);
+	}
+#endif
+
+	if (_enumeratorThread.joinable())
+		_enumeratorThread.join();
+
+#ifdef __linux__
+	for (const int fd: _wakeUpPipe)
+		if (fd >= 0)
+			::close(fd);
+#endif
+}
+
+void CDiskEnumerator::requestFreeSpaceUpdate(size_t driveIndex)
+{
+	if (driveIndex >= _drives.size())
+		return;
+
+	const QString rootPath = _drives[driveIndex].rootPath;
+	FreeSpaceQuery& query = _freeSpaceQueries[rootPath];
+	const int64_t now = monotonicTimeMs();
+	// A drive that doesn't respond (e.g. an unreachable network share) is not queried again until the query in progress returns
+	if (query.inProgress || now - query.lastStarted < _freeSpaceUpdateInterval)
+		return;
+
+	query.inProgress = true;
+	query.lastStarted = now;
+
+	QTimer::singleShot((int)_freeSpaceQueryTimeout, this, [this, rootPath, now]() {
+		auto it = _freeSpaceQueries.find(rootPath);
+		if (it != _freeSpaceQueries.end() && it->second.inProgress && it->second.lastStarted == now)
+		{
+			it->second.timedOut = true;
+			qDebug() << "CDiskEnumerator: drive" << rootPath << "is not responding";
+			driveNotResponding(rootPath);
+		}
 	});
+
+	// statfs() can block indefinitely, so it's not done on the shared worker threads
+	std::shared_ptr<QueryContext> context = _queryContext;
+	std::thread([context, rootPath]() {
+		const QStorageInfo storageInfo(rootPath);
+
+		std::lock_guard<std::mutex> locker(context->mutex);
+		if (context->enumerator)
+		{
+			CDiskEnumerator* enumerator = context->enumerator;
+			enumerator->_notificationsQueue.enqueue([enumerator, rootPath, storageInfo]() {
+				enumerator->freeSpaceUpdated(rootPath, storageInfo);
+			});
+		}
+	}).detach();
+}
+
+void CDiskEnumerator::enumeratorThreadFunc()
+{
+	enumerateDisks(true);
+
+#ifdef __linux__
+	// The kernel flags /proc/self/mountinfo with POLLPRI | POLLERR whenever a file system is mounted or unmounted, so the table is only re-read when it has actually changed
+	const int mountTable = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+	if (mountTable >= 0 && _wakeUpPipe[0] >= 0)
+	{
+		pollfd fds[2];
+		fds[0].fd = mountTable;
+		fds[0].events = POLLPRI;
+		fds[1].fd = _wakeUpPipe[0];
+		fds[1].events = POLLIN;
+
+		while (!_terminate)
+		{
+			fds[0].revents = fds[1].revents = 0;
+			if (::poll(fds, 2, -1) < 0)
+			{
+				if (errno == EINTR)
+					continue;
+
+				qDebug() << "CDiskEnumerator: waiting for the mount table changes failed, errno" << errno;
+				break;
+			}
+
+			if (_terminate)
+				break;
+
+			if (fds[0].revents & (POLLPRI | POLLERR))
+				enumerateDisks(true);
+		}
+
+		::close(mountTable);
+		if (_terminate)
+			return;
+	}
+	else
+	{
+		qDebug() << "CDiskEnumerator: cannot watch /proc/self/mountinfo, polling the mount table instead";
+		if (mountTable >= 0)
+			::close(mountTable);
+	}
+#endif
+
+	std::unique_lock<std::mutex> locker(_terminationMutex);
+	while (!_terminationCondition.wait_for(locker, std::chrono::milliseconds((int64_t)_updateInterval), [this]() {return _terminate.load();}))
+	{
+		locker.unlock();
+		enumerateDisks(true);
+		locker.lock();
+	}
 }
 
-// A helper function that checks if there are any changes between the old and the new disk lists - including the change in space available
-static bool operator!=(const QList<QStorageInfo>& newList, const std::vector<CDiskEnumerator::DiskInfo>& oldList)
+#ifdef __linux__
+// The mount table escapes spaces, tabs, newlines and backslashes in the paths as octal codes (\040 etc.)
+static QByteArray unescapeMountTableField(const QByteArray& field)
 {
-	if (newList.size() != (int)oldList.size())
+	QByteArray result;
+	result.reserve(field.size());
+	for (int i = 0; i < field.size(); ++i)
+	{
+		if (field[i] == '\\' && i + 3 < field.size() && field[i + 1] >= '0' && field[i + 1] <= '3')
+		{
+			bool ok = false;
+			const int code = field.mid(i + 1, 3).toInt(&ok, 8);
+			if (ok)
+			{
+				result.append((char)code);
+				i += 3;
+				continue;
+			}
+		}
+
+		result.append(field[i]);
+	}
+
+	return result;
+}
+
+// File systems that only expose kernel state and are not drives; QStorageInfo::mountedVolumes() drops them for reporting zero size, which takes a statfs() call to find out
+static bool isPseudoFileSystem(const QString& mountPoint, const QByteArray& type)
+{
+	static const char* const pseudoMountPoints[] {"/dev", "/proc", "/sys", "/var/run", "/var/lock"};
+	for (const char* pseudoMountPoint: pseudoMountPoints)
+	{
+		const QString pseudoMountPointPath = QString::fromLatin1(pseudoMountPoint);
+		if (mountPoint == pseudoMountPointPath || mountPoint.startsWith(pseudoMountPointPath + '/'))
+			return true;
+	}
+
+	static const char* const pseudoFileSystems[] {"rootfs", "proc", "sysfs", "cgroup", "cgroup2", "devpts", "devtmpfs", "mqueue", "debugfs", "tracefs", "securityfs", "pstore", "bpf", "configfs",
+		"fusectl", "binfmt_misc", "autofs", "rpc_pipefs", "nsfs", "efivarfs", "selinuxfs", "hugetlbfs", "nfsd"};
+	for (const char* pseudoFileSystem: pseudoFileSystems)
+		if (type == pseudoFileSystem)
+			return true;
+
+	return false;
+}
+
+// Volume labels by the canonical device path, as udev publishes them in /dev/disk/by-label (with the special characters escaped as \xHH)
+static std::map<QString, QString> volumeLabels()
+{
+	std::map<QString, QString> labels;
+	for (const QFileInfo& link: QDir("/dev/disk/by-label").entryInfoList(QDir::System | QDir::Files | QDir::NoDotAndDotDot))
+	{
+		const QByteArray escapedLabel = link.fileName().toUtf8();
+		QByteArray label;
+		for (int i = 0; i < escapedLabel.size(); ++i)
+		{
+			if (escapedLabel[i] == '\\' && i + 3 < escapedLabel.size() && escapedLabel[i + 1] == 'x')
+			{
+				bool ok = false;
+				const int code = escapedLabel.mid(i + 2, 2).toInt(&ok, 16);
+				if (ok)
+				{
+					label.append((char)code);
+					i += 3;
+					continue;
+				}
+			}
+
+			label.append(escapedLabel[i]);
+		}
+
+		labels[link.canonicalFilePath()] = QString::fromUtf8(label);
+	}
+
+	return labels;
+}
+#endif
+
+std::vector<CDiskEnumerator::DiskInfo> CDiskEnumerator::mountedDrives(const std::vector<DiskInfo>& previousDrives)
+{
+	std::vector<DiskInfo> drives;
+
+#ifdef __linux__
+	// The mount table is read directly: QStorageInfo::mountedVolumes() calls statfs() on every mount, which blocks on an unreachable network share and adds up on hosts with hundreds of mounts
+	QFile mountTable("/proc/self/mountinfo");
+	if (mountTable.open(QFile::ReadOnly))
+	{
+		std::map<QString, QString> labels;
+		bool labelsRead = false;
+
+		for (const QByteArray& line: mountTable.readAll().split('\n'))
+		{
+			// ID, parent ID, major:minor, root, mount point, mount options, optional fields, "-", file system type, source, super block options
+			const QList<QByteArray> fields = line.split(' ');
+			const int separator = fields.indexOf("-", 6);
+			if (separator < 0 || separator + 2 >= fields.size())
+				continue;
+
+			DiskInfo drive;
+			drive.rootPath = QString::fromUtf8(unescapeMountTableField(fields[4]));
+			drive.fileSystemType = fields[separator + 1];
+			drive.device = unescapeMountTableField(fields[separator + 2]);
+			if (isPseudoFileSystem(drive.rootPath, drive.fileSystemType))
+				continue;
+
+			if (drive.device.startsWith("/dev/"))
+			{
+				if (!labelsRead)
+				{
+					labels = volumeLabels();
+					labelsRead = true;
+				}
+
+				const auto label = labels.find(QFileInfo(QString::fromUtf8(drive.device)).canonicalFilePath());
+				if (label != labels.end())
+					drive.name = label->second;
+			}
+
+			// Creating the file system object accesses the drive, so it's only done for the newly mounted ones
+			const auto previousDrive = std::find_if(previousDrives.cbegin(), previousDrives.cend(), [&drive](const DiskInfo& item) {
+				return item.rootPath == drive.rootPath && item.device == drive.device && item.fileSystemType == drive.fileSystemType;
+			});
+			drive.fileSystemObject = previousDrive != previousDrives.cend() ? previousDrive->fileSystemObject : CFileSystemObject(drive.rootPath);
+
+			drives.push_back(drive);
+		}
+
+		return drives;
+	}
+
+	qDebug() << "CDiskEnumerator: cannot read /proc/self/mountinfo, querying all the mounted volumes instead";
+#else
+	Q_UNUSED(previousDrives);
+#endif
+
+	for (const QStorageInfo& storageInfo: QStorageInfo::mountedVolumes())
+		drives.emplace_back(storageInfo);
+
+	return drives;
+}
+
+// A helper function that checks if the set of mounted drives has changed. The free space is not compared, it's updated separately by requestFreeSpaceUpdate()
+static bool mountListChanged(const std::vector<CDiskEnumerator::DiskInfo>& newList, const std::vector<CDiskEnumerator::DiskInfo>& oldList)
+{
+	if (newList.size() != oldList.size())
 		return true;
 
-	for (int i = 0; i < newList.size(); ++i)
+	for (size_t i = 0; i < newList.size(); ++i)
 	{
-		const QStorageInfo& l = newList[i];
-		const QStorageInfo& r = oldList[i].storageInfo;
-		if ((l.name() % l.rootPath() % QString::number(l.bytesAvailable())) != (r.name() % r.rootPath() % QString::number(r.bytesAvailable())))
+		const CDiskEnumerator::DiskInfo& l = newList[i];
+		const CDiskEnumerator::DiskInfo& r = oldList[i];
+		if (l.name != r.name || l.rootPath != r.rootPath || l.device != r.device || l.fileSystemType != r.fileSystemType || l.isReady != r.isReady)
 			return true;
 	}
 
@@ -58,28 +377,100 @@ static bool operator!=(const QList<QStorageInfo>& newList, const std::vector<CDi
 // Refresh the list of available disk drives
 void CDiskEnumerator::enumerateDisks(bool async)
 {
-	const auto newDrives = QStorageInfo::mountedVolumes();
+	// _lastEnumeratedDrives belongs to the worker thread, a synchronous update can't use it
+	const std::vector<DiskInfo> newDrives = mountedDrives(async ? _lastEnumeratedDrives : std::vector<DiskInfo>());
+
+	if (!async)
+	{
+		setDrives(newDrives);
+		notifyObservers(false);
+	}
+	else if (mountListChanged(newDrives, _lastEnumeratedDrives))
+	{
+		_lastEnumeratedDrives = newDrives;
+		// Queuing the update to be applied on the thread where CDiskEnumerator was created, so that drives() never changes under its callers
+		_notificationsQueue.enqueue([this, newDrives]() {
+			setDrives(newDrives);
+			notifyObservers(true);
+		}, 1); // Only the latest list matters if several are pending
+	}
+}
 
-	if (!async || newDrives != _drives)
+void CDiskEnumerator::setDrives(std::vector<DiskInfo> drives)
+{
+	for (DiskInfo& drive: drives)
 	{
-		_drives.resize((size_t)newDrives.size());
-		std::copy(newDrives.cbegin(), newDrives.cend(), _drives.begin());
+		// Where the drive list comes with the free space, it's the latest there is
+		if (drive.freeSpaceQueried)
+			continue;
 
-		notifyObservers(async);
+		const auto previousDrive = std::find_if(_drives.cbegin(), _drives.cend(), [&drive](const DiskInfo& item) {return item.rootPath == drive.rootPath && item.device == drive.device;});
+		if (previousDrive == _drives.cend())
+			continue;
+
+		drive.isReady = previousDrive->isReady;
+		drive.isResponding = previousDrive->isResponding;
+		drive.freeSpaceQueried = previousDrive->freeSpaceQueried;
+		drive.bytesTotal = previousDrive->bytesTotal;
+		drive.bytesFree = previousDrive->bytesFree;
+		drive.bytesAvailable = previousDrive->bytesAvailable;
+	}
+
+	_drives = std::move(drives);
+}
+
+void CDiskEnumerator::freeSpaceUpdated(const QString& rootPath, const QStorageInfo& storageInfo)
+{
+	FreeSpaceQuery& query = _freeSpaceQueries[rootPath];
+	query.inProgress = false;
+	if (query.timedOut)
+	{
+		query.timedOut = false;
+		qDebug() << "CDiskEnumerator: drive" << rootPath << "has responded after" << monotonicTimeMs() - query.lastStarted << "ms";
+	}
+
+	const bool isReady = storageInfo.isValid() && storageInfo.isReady();
+	for (DiskInfo& drive: _drives)
+	{
+		if (drive.rootPath != rootPath)
+			continue;
+
+		if (!drive.freeSpaceQueried || !drive.isResponding || drive.isReady != isReady || drive.bytesAvailable != storageInfo.bytesAvailable() || drive.bytesFree != storageInfo.bytesFree() || drive.bytesTotal != storageInfo.bytesTotal())
+		{
+			drive.isReady = isReady;
+			drive.isResponding = true;
+			drive.freeSpaceQueried = true;
+			drive.bytesTotal = storageInfo.bytesTotal();
+			drive.bytesFree = storageInfo.bytesFree();
+			drive.bytesAvailable = storageInfo.bytesAvailable();
+			notifyObservers(true);
+		}
+
+		break;
+	}
+}
+
+void CDiskEnumerator::driveNotResponding(const QString& rootPath)
+{
+	for (DiskInfo& drive: _drives)
+	{
+		if (drive.rootPath != rootPath || !drive.isResponding)
+			continue;
+
+		drive.isResponding = false;
+		notifyObservers(true);
+		break;
 	}
 }
 
 // Calls all the registered observers with the latest list of drives found
 void CDiskEnumerator::notifyObservers(bool async) const
 {
-	// This method is called from the worker thread
-	// Queuing the code to be executed on the thread where CDiskEnumerator was created
-
 	_notificationsQueue.enqueue([this]() {
 		for (auto& observer : _observers)
 			observer->disksChanged();
-	}, 0); // Setting the tag to 0 will discard any previous queue items with the same tag that have not yet been processed
+	}, 0); // Setting the tag to 0 will replace the previous queue item with the same tag if it has not yet been processed
 
 	if (!async)
-		_notificationsQueue.exec();
+		_notificationsQueue.processPendingTasks();
 }
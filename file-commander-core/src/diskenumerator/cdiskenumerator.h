@@ -2,14 +2,18 @@
 #define CDISKENUMERATOR_H
 
 #include "cfilesystemobject.h"
-#include "threading/cexecutionqueue.h"
-#include "threading/cperiodicexecutionthread.h"
+#include "uithreaddispatcher/cuithreaddispatcher.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QStorageInfo>
-#include <QTimer>
 RESTORE_COMPILER_WARNINGS
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 
@@ -17,17 +21,34 @@ RESTORE_COMPILER_WARNINGS
 class CDiskEnumerator : protected QObject
 {
 public:
+	// The mount itself is known from the mount table, the free space is only known once the drive has been queried by requestFreeSpaceUpdate()
 	struct DiskInfo
 	{
 		DiskInfo() = default;
-		DiskInfo(const QStorageInfo& qStorageInfo) : storageInfo(qStorageInfo), fileSystemObject(qStorageInfo.rootPath()) {}
+		explicit DiskInfo(const QStorageInfo& qStorageInfo);
 
-		QStorageInfo      storageInfo;
+		// The volume label if there is one, the root path otherwise
+		QString displayName() const;
+		// The free space figures can be displayed
+		bool freeSpaceIsKnown() const;
+
+		QString           rootPath;
+		QString           name;
+		QByteArray        device;
+		QByteArray        fileSystemType;
 		CFileSystemObject fileSystemObject;
+
+		bool              isReady = true; // False if the file system could not be queried (e. g. an empty drive)
+		bool              isResponding = true; // False while a query of the drive is taking too long (e. g. an unreachable network share)
+		bool              freeSpaceQueried = false;
+		qint64            bytesTotal = 0;
+		qint64            bytesFree = 0;
+		qint64            bytesAvailable = 0;
 	};
 
 
 	CDiskEnumerator();
+	~CDiskEnumerator();
 
 	// Disk list observer interface
 	class IDiskListObserver
@@ -41,27 +62,68 @@ public:
 	void addObserver(IDiskListObserver * observer);
 	// Removes the observer
 	void removeObserver(IDiskListObserver * observer);
-	// Returns the drives found
+	// Returns the drives found. Must only be called on the thread where CDiskEnumerator was created
 	const std::vector<DiskInfo>& drives() const;
 
 	// Forces an update in this thread
 	void updateSynchronously();
 
+	// Re-reads the free space of the drive in the background, the observers are notified if it has changed.
+	// Can be called as often as needed: a drive is queried at most once per _freeSpaceUpdateInterval, and not at all while the previous query hasn't returned
+	void requestFreeSpaceUpdate(size_t driveIndex);
+
 private:
+	// Waits for the mount table to change and re-reads the list of drives whenever it does
+	void enumeratorThreadFunc();
+
 	// Refresh the list of available disk drives
 	void enumerateDisks(bool async);
+	// Reads the list of mounted drives without querying them where possible, so that neither an unresponsive drive nor a large number of mounts can hold up the enumeration.
+	// The drives that are also on the previous list are not accessed at all.
+	static std::vector<DiskInfo> mountedDrives(const std::vector<DiskInfo>& previousDrives);
+	// Replaces the drive list with the one read by the worker thread, keeping the free space already known for the drives that are still mounted
+	void setDrives(std::vector<DiskInfo> drives);
+	// Stores the free space read by a background query
+	void freeSpaceUpdated(const QString& rootPath, const QStorageInfo& storageInfo);
+	// Marks the drive whose free space query has timed out, its free space is no longer current
+	void driveNotResponding(const QString& rootPath);
 
 	// Calls all the registered observers with the latest list of drives found
 	void notifyObservers(bool async) const;
 
 private:
-	std::vector<DiskInfo>           _drives;
+	struct FreeSpaceQuery
+	{
+		int64_t lastStarted = 0;
+		bool    inProgress = false;
+		bool    timedOut = false;
+	};
+
+	// Free space queries run on detached threads that may outlive the enumerator (a hung network share doesn't return for minutes), and only deliver their results while it still exists
+	struct QueryContext
+	{
+		std::mutex        mutex;
+		CDiskEnumerator * enumerator = nullptr;
+	};
+
+private:
+	std::vector<DiskInfo>           _drives; // Only accessed on the thread where CDiskEnumerator was created
 	std::vector<IDiskListObserver*> _observers;
-	mutable CExecutionQueue         _notificationsQueue;
-	CPeriodicExecutionThread        _enumeratorThread;
-	QTimer                          _timer;
+	mutable CUiThreadDispatcher     _notificationsQueue;
+
+	std::map<QString, FreeSpaceQuery> _freeSpaceQueries; // By the drive root path
+	std::shared_ptr<QueryContext>   _queryContext;
+
+	std::vector<DiskInfo>           _lastEnumeratedDrives; // Only accessed by the worker thread
+	std::thread                     _enumeratorThread;
+	std::atomic<bool>               _terminate {false};
+	std::mutex                      _terminationMutex;
+	std::condition_variable         _terminationCondition;
+	int                             _wakeUpPipe[2] {-1, -1}; // For interrupting the wait for mount table changes
 
-	static const unsigned int       _updateInterval = 1000; // ms
+	static const unsigned int       _updateInterval = 1000; // ms, only used where the mount table changes cannot be waited for
+	static const int64_t            _freeSpaceUpdateInterval = 1000; // ms
+	static const int64_t            _freeSpaceQueryTimeout = 3000; // ms
 };
 
 #endif // CDISKENUMERATOR_H
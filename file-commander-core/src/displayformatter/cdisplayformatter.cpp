@@ -0,0 +1,139 @@
+#include "cdisplayformatter.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDateTime>
+RESTORE_COMPILER_WARNINGS
+
+// The caches are simply flushed once they grow this large; a listing rarely has that many distinct values on screen
+static const size_t maxCachedStrings = 8192;
+
+inline static int64_t floorDiv(int64_t a, int64_t b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Converts the number of days since 01.01.1970 to the Gregorian calendar date
+inline static void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day)
+{
+	days += 719468;
+	const int64_t era = floorDiv(days, 146097);
+	const unsigned dayOfEra = (unsigned)(days - era * 146097);
+	const unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	const unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	const unsigned shiftedMonth = (5 * dayOfYear + 2) / 153; // Starting from March
+	day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+	month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+	year = (int64_t)yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+}
+
+inline static void writeTwoDigits(QChar * dest, unsigned value)
+{
+	dest[0] = QChar('0' + (value / 10) % 10);
+	dest[1] = QChar('0' + value % 10);
+}
+
+// Same output as fileSizeToString(size)
+const QString& CDisplayFormatter::sizeString(uint64_t size)
+{
+	static const uint64_t KB = 1024, MB = 1024 * KB, GB = 1024 * MB;
+	static const char* const unitSuffixes[] = {" B", " KiB", " MiB", " GiB"};
+
+	unsigned unitIndex = 0;
+	uint64_t unitSize = 1;
+	if (size >= GB)
+	{
+		unitIndex = 3;
+		unitSize = GB;
+	}
+	else if (size >= MB)
+	{
+		unitIndex = 2;
+		unitSize = MB;
+	}
+	else if (size >= KB)
+	{
+		unitIndex = 1;
+		unitSize = KB;
+	}
+
+	// All the sizes that look the same share one cache entry
+	const uint64_t displayedValue = unitIndex == 0 ? size : (size * 10 + unitSize / 2) / unitSize;
+	const uint64_t key = displayedValue * 4 + unitIndex;
+	const auto cached = _sizeStrings.find(key);
+	if (cached != _sizeStrings.end())
+		return cached->second;
+
+	if (_sizeStrings.size() >= maxCachedStrings)
+		_sizeStrings.clear();
+
+	QString str;
+	if (unitIndex == 0)
+		str = QString::number(displayedValue);
+	else
+	{
+		str = QString::number(displayedValue / 10);
+		str += '.';
+		str += QChar('0' + (int)(displayedValue % 10));
+	}
+
+	str += QLatin1String(unitSuffixes[unitIndex]);
+	return _sizeStrings[key] = str;
+}
+
+// The local date and time in the "dd.MM.yyyy hh:mm" format
+const QString& CDisplayFormatter::dateString(time_t utcTimestamp)
+{
+	const int64_t utcSeconds = (int64_t)(uint)utcTimestamp; // The same conversion as the QDateTime::setTime_t((uint)timestamp) this replaces
+	const int64_t utcMinute = floorDiv(utcSeconds, 60);
+	const auto cached = _dateStrings.find(utcMinute);
+	if (cached != _dateStrings.end())
+		return cached->second;
+
+	if (_dateStrings.size() >= maxCachedStrings)
+		_dateStrings.clear();
+
+	const int64_t localSeconds = utcSeconds + utcOffsetSeconds(utcSeconds);
+	const int64_t days = floorDiv(localSeconds, 86400);
+	const unsigned secondOfDay = (unsigned)(localSeconds - days * 86400);
+
+	int64_t year = 0;
+	unsigned month = 0, day = 0;
+	civilFromDays(days, year, month, day);
+
+	QString str(16, QChar('.'));
+	QChar * data = str.data();
+	writeTwoDigits(data, day);
+	writeTwoDigits(data + 3, month);
+	writeTwoDigits(data + 6, (unsigned)(year / 100));
+	writeTwoDigits(data + 8, (unsigned)(year % 100));
+	data[10] = ' ';
+	writeTwoDigits(data + 11, secondOfDay / 3600);
+	data[13] = ':';
+	writeTwoDigits(data + 14, (secondOfDay / 60) % 60);
+
+	return _dateStrings[utcMinute] = str;
+}
+
+// Forgets the cached strings and time zone offsets, e. g. if the time zone has changed
+void CDisplayFormatter::clear()
+{
+	_sizeStrings.clear();
+	_dateStrings.clear();
+	_utcOffsetForHour.clear();
+}
+
+int CDisplayFormatter::utcOffsetSeconds(int64_t utcSeconds)
+{
+	// Daylight saving time transitions happen on hour boundaries, so the offset only has to be looked up once per hour
+	const int64_t utcHour = floorDiv(utcSeconds, 3600);
+	const auto cached = _utcOffsetForHour.find(utcHour);
+	if (cached != _utcOffsetForHour.end())
+		return cached->second;
+
+	if (_utcOffsetForHour.size() >= maxCachedStrings)
+		_utcOffsetForHour.clear();
+
+	const int offset = QDateTime::fromMSecsSinceEpoch(utcHour * 3600 * 1000).offsetFromUtc();
+	_utcOffsetForHour[utcHour] = offset;
+	return offset;
+}
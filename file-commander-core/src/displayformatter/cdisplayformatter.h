@@ -0,0 +1,32 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+#include <stdint.h>
+#include <time.h>
+#include <unordered_map>
+
+// Produces the size and date strings for the file list, remembering the recent results. Not thread-safe, meant to be owned by a single view.
+class CDisplayFormatter
+{
+public:
+	// Same output as fileSizeToString(size)
+	const QString& sizeString(uint64_t size);
+	// The local date and time in the "dd.MM.yyyy hh:mm" format
+	const QString& dateString(time_t utcTimestamp);
+
+	// Forgets the cached strings and time zone offsets, e. g. if the time zone has changed
+	void clear();
+
+private:
+	int utcOffsetSeconds(int64_t utcSeconds);
+
+private:
+	std::unordered_map<uint64_t, QString> _sizeStrings; // Keyed by the displayed value: bytes, or tenths of the unit plus the unit index
+	std::unordered_map<int64_t, QString>  _dateStrings; // Keyed by UTC minute
+	std::unordered_map<int64_t, int>      _utcOffsetForHour; // Keyed by UTC hour
+};
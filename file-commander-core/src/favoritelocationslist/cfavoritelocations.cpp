@@ -1,6 +1,6 @@
 #include "cfavoritelocations.h"
 #include "settings.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 #include "assert/advanced_assert.h"
 
 #include <stack>
@@ -43,7 +43,7 @@ static inline void serialize(QByteArray& dest, const CLocationsCollection& sourc
 
 CFavoriteLocations::CFavoriteLocations()
 {
-	load(CSettings().value(KEY_FAVORITES).toByteArray());
+	load(CSettingsStore::get().value(KEY_FAVORITES).toByteArray());
 }
 
 CFavoriteLocations::~CFavoriteLocations()
@@ -102,5 +102,5 @@ void CFavoriteLocations::save()
 	QByteArray data;
 	for (const CLocationsCollection& item : _items)
 		serialize(data, item, NoMarker);
-	CSettings().setValue(KEY_FAVORITES, data);
+	CSettingsStore::get().setValue(KEY_FAVORITES, data);
 }
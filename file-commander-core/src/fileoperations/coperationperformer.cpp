@@ -1,14 +1,21 @@
 #include "coperationperformer.h"
 #include "filesystemhelperfunctions.h"
 
+#include <algorithm>
+#include <errno.h>
 #include <functional>
+#include <limits>
+#include <string.h>
 
 #ifdef _WIN32
 #include <Windows.h>
 #else
 #include <unistd.h>
+#include <sys/stat.h>
 #endif
 
+static const size_t noHardlinkOrigin = std::numeric_limits<size_t>::max();
+
 inline QDir destinationFolder(const QString &absoluteSourcePath, const QString &originPath, const QString &destPath, bool /*sourceIsDir*/)
 {
 	QString localPath = absoluteSourcePath.mid(originPath.length());
@@ -31,6 +38,10 @@ COperationPerformer::COperationPerformer(Operation operation, std::vector<CFileS
 	_finished(false),
 	_cancelRequested(false),
 	_userResponse(urNone),
+	_preserveHardlinks(false),
+	_overwriteChangedBlocksOnly(false),
+	_bytesComparedWhenOverwriting(0),
+	_bytesWrittenWhenOverwriting(0),
 	_observer(0)
 {
 }
@@ -49,6 +60,18 @@ void COperationPerformer::setWatcher(CFileOperationObserver *watcher)
 	_observer = watcher;
 }
 
+void COperationPerformer::setPreserveHardlinks(bool preserve)
+{
+	assert_r(!_inProgress);
+	_preserveHardlinks = preserve;
+}
+
+void COperationPerformer::setOverwriteChangedBlocksOnly(bool changedBlocksOnly)
+{
+	assert_r(!_inProgress);
+	_overwriteChangedBlocksOnly = changedBlocksOnly;
+}
+
 bool COperationPerformer::togglePause()
 {
 	_paused = !_paused;
@@ -242,28 +265,42 @@ void COperationPerformer::copyFiles()
 			continue;
 		}
 
+		bool sizeAccountedFor = false;
 		if (it->isFile())
 		{
 			NextAction nextAction;
-			while ((nextAction = copyItem(*it, destInfo, destination[currentItemIndex], sizeProcessed, totalSize, currentItemIndex)) == naRetryOperation);
-			switch (nextAction)
+			sizeAccountedFor = linkToAlreadyCopiedInode(currentItemIndex, destInfo);
+			if (!sizeAccountedFor)
 			{
-			case naProceed:
-				break;
-			case naSkip:
-				++it;
-				++currentItemIndex;
-				continue;
-			case naRetryItem:
-				continue;
-			case naRetryOperation:
-			case naAbort:
-				finalize();
-				return;
-			default:
-				qDebug() << QString("Unexpected deleteItem() return value %1").arg(nextAction);
-				assert_unconditional_r("Unexpected deleteItem() return value");
-				continue; // Retry
+				while ((nextAction = copyItem(*it, destInfo, destination[currentItemIndex], sizeProcessed, totalSize, currentItemIndex)) == naRetryOperation);
+				switch (nextAction)
+				{
+				case naProceed:
+					break;
+				case naSkip:
+					++it;
+					++currentItemIndex;
+					continue;
+				case naRetryItem:
+					continue;
+				case naRetryOperation:
+				case naAbort:
+					finalize();
+					return;
+				default:
+					qDebug() << QString("Unexpected deleteItem() return value %1").arg(nextAction);
+					assert_unconditional_r("Unexpected deleteItem() return value");
+					continue; // Retry
+				}
+
+				// The rest of the links to this inode will point to the first copy that has been written, and its data is only accounted for once
+				const size_t origin = currentItemIndex < _hardlinkOrigin.size() ? _hardlinkOrigin[currentItemIndex] : noHardlinkOrigin;
+				if (origin != noHardlinkOrigin)
+				{
+					sizeAccountedFor = _hardlinkDestPath.count(origin) != 0;
+					if (!sizeAccountedFor)
+						_hardlinkDestPath[origin] = destInfo.absoluteFilePath();
+				}
 			}
 
 			if (_op == operationMove) // result == ok
@@ -348,7 +385,8 @@ void COperationPerformer::copyFiles()
 			}
 		}
 
-		sizeProcessed += it->size();
+		if (!sizeAccountedFor)
+			sizeProcessed += it->size();
 
 		++it;
 		++currentItemIndex;
@@ -436,7 +474,15 @@ void COperationPerformer::finalize()
 {
 	_finished = true;
 	_paused   = false;
-	_observer->onProcessFinishedCallback();
+
+	QString message;
+	if (_bytesComparedWhenOverwriting > _bytesWrittenWhenOverwriting)
+		message = QObject::tr("Only the changed blocks of the overwritten files were written: %1 out of %2 (%3 saved).").
+			arg(fileSizeToString(_bytesWrittenWhenOverwriting)).
+			arg(fileSizeToString(_bytesComparedWhenOverwriting)).
+			arg(fileSizeToString(_bytesComparedWhenOverwriting - _bytesWrittenWhenOverwriting));
+
+	_observer->onProcessFinishedCallback(message);
 }
 
 // Iterates over all dirs in the source vector, and their subdirs, and so on and replaces _sources with a flat list of files. Returns a list of destination folders where each of the files must be copied to according to _dest
@@ -446,12 +492,44 @@ std::vector<QDir> COperationPerformer::flattenSourcesAndCalcDest(uint64_t &total
 	totalSize = 0;
 	std::vector<CFileSystemObject> newSourceVector;
 	std::vector<QDir> destinations;
+	_hardlinkOrigin.clear();
+	_hardlinkDestPath.clear();
+
+#if defined __linux__ || defined __APPLE__
+	std::map<std::pair<dev_t, ino_t>, size_t> firstItemForInode;
+#endif
+	// Must be called before the item is added to newSourceVector. Returns false if the item is a hard link to an inode that has already been registered
+	const auto registerItemInode = [&](const CFileSystemObject& item) -> bool {
+		// Links are only preserved when copying, there's no point in looking them up for the other operations
+		if (_op == operationDelete)
+			return true;
+
+		size_t origin = noHardlinkOrigin;
+#if defined __linux__ || defined __APPLE__
+		struct stat info;
+		if (_preserveHardlinks && item.isFile() && lstat(item.fullAbsolutePath().toUtf8().constData(), &info) == 0 && info.st_nlink > 1)
+		{
+			const auto inode = std::make_pair(info.st_dev, info.st_ino);
+			const auto firstItem = firstItemForInode.find(inode);
+			if (firstItem != firstItemForInode.end())
+				origin = firstItem->second;
+			else
+				origin = firstItemForInode[inode] = newSourceVector.size();
+		}
+#else
+		Q_UNUSED(item);
+#endif
+		_hardlinkOrigin.push_back(origin);
+		return origin == noHardlinkOrigin || origin == newSourceVector.size();
+	};
+
 	const bool destIsFileName = _source.size() == 1 && !_destFileSystemObject.isDir();
 	for (auto& o: _source)
 	{
 		if (o.isFile())
 		{
-			totalSize += o.size();
+			if (registerItemInode(o))
+				totalSize += o.size();
 			// Ignoring the new file name here if it was supplied. We're only calculating dest dir here, not the file name
 			destinations.emplace_back(destinationFolder(o.fullAbsolutePath(), o.parentDirPath(), destIsFileName ? _destFileSystemObject.parentDirPath() : _destFileSystemObject.fullAbsolutePath(), false));
 			newSourceVector.push_back(o);
@@ -461,10 +539,12 @@ std::vector<QDir> COperationPerformer::flattenSourcesAndCalcDest(uint64_t &total
 			auto children = recurseDirectoryItems(o.fullAbsolutePath(), true);
 			for (auto& file : children)
 			{
-				totalSize += file.size();
+				if (registerItemInode(file))
+					totalSize += file.size();
 				destinations.emplace_back(destinationFolder(file.fullAbsolutePath(), o.parentDirPath(), _destFileSystemObject.fullAbsolutePath(), file.isDir()));
 				newSourceVector.push_back(file);
 			}
+			registerItemInode(o);
 			destinations.emplace_back(destinationFolder(o.fullAbsolutePath(), o.parentDirPath(), _destFileSystemObject.fullAbsolutePath(), true));
 			newSourceVector.push_back(o);
 		}
@@ -558,6 +638,7 @@ COperationPerformer::NextAction COperationPerformer::copyItem(CFileSystemObject&
 		return naProceed;
 
 	CFileSystemObject destFile(destInfo);
+	bool overwritingExistingFile = false;
 
 	if (destFile.exists() && destFile.isFile())
 	{
@@ -578,6 +659,8 @@ COperationPerformer::NextAction COperationPerformer::copyItem(CFileSystemObject&
 			assert_unconditional_r("Unexpected user response");
 			return naRetryItem;
 		}
+		else
+			overwritingExistingFile = true;
 
 		// Only call isWriteable for existing items!
 		if (!destFile.isWriteable())
@@ -624,12 +707,13 @@ COperationPerformer::NextAction COperationPerformer::copyItem(CFileSystemObject&
 			_fileTimeElapsed.resume();
 		}
 
-		result = item.copyChunk(chunkSize, destPath, _newName.isEmpty() ? (!destFile.isDir() ? destFile.fullName() : QString::null) : _newName);
+		result = item.copyChunk(chunkSize, destPath, _newName.isEmpty() ? (!destFile.isDir() ? destFile.fullName() : QString::null) : _newName, overwritingExistingFile && _overwriteChangedBlocksOnly);
 		// Error handling
 		if (result != rcOk)
 			break;
 
-		const float totalPercentage = totalSize > 0 ? float(sizeProcessed + item.bytesCopied()) * 100.0f / totalSize : 0.0f;
+		// A hard link that could not be linked is copied in full even though its data is counted once in the total
+		const float totalPercentage = totalSize > 0 ? std::min(float(sizeProcessed + item.bytesCopied()) * 100.0f / totalSize, 100.0f) : 0.0f;
 		const float filePercentage = item.size() > 0 ? item.bytesCopied() * 100.0f / item.size() : 0.0f;
 		const uint64_t speed = _fileTimeElapsed.elapsed() > 0 ? item.bytesCopied() * 1000 / _fileTimeElapsed.elapsed() : 0; // B/s
 		_smoothSpeedCalculator = speed;
@@ -663,6 +747,12 @@ COperationPerformer::NextAction COperationPerformer::copyItem(CFileSystemObject&
 		}
 	}
 
+	if (overwritingExistingFile && _overwriteChangedBlocksOnly && !_cancelRequested)
+	{
+		_bytesComparedWhenOverwriting += item.bytesCopied();
+		_bytesWrittenWhenOverwriting += item.bytesWritten();
+	}
+
 	return naProceed;
 }
 
@@ -684,3 +774,37 @@ COperationPerformer::NextAction COperationPerformer::mkPath(const QDir& dir)
 		return naRetryItem;
 	}
 }
+
+// Recreates the item as a hard link to the first copy of the same inode that has been written. Returns false if the item must be copied instead
+bool COperationPerformer::linkToAlreadyCopiedInode(size_t itemIndex, const QFileInfo& destInfo)
+{
+#if defined __linux__ || defined __APPLE__
+	if (itemIndex >= _hardlinkOrigin.size())
+		return false;
+
+	const size_t origin = _hardlinkOrigin[itemIndex];
+	if (origin == noHardlinkOrigin)
+		return false;
+
+	// Until one of the links has been copied successfully (e. g. the earlier ones were skipped), this one is copied normally
+	const auto originDest = _hardlinkDestPath.find(origin);
+	if (originDest == _hardlinkDestPath.end())
+		return false;
+
+	// Existing destination files are handled by copyItem() which asks the user what to do
+	if (destInfo.exists() || !QDir().mkpath(destInfo.absolutePath()))
+		return false;
+
+	if (::link(originDest->second.toUtf8().constData(), destInfo.absoluteFilePath().toUtf8().constData()) != 0)
+	{
+		qDebug() << __FUNCTION__ << "Failed to link" << destInfo.absoluteFilePath() << "to" << originDest->second << ", error:" << strerror(errno) << ". Copying instead.";
+		return false;
+	}
+
+	return true;
+#else
+	Q_UNUSED(itemIndex);
+	Q_UNUSED(destInfo);
+	return false;
+#endif
+}
@@ -81,6 +81,10 @@ public:
 	~COperationPerformer();
 
 	void setWatcher(CFileOperationObserver *watcher);
+	// If enabled, files that are hard links to the same inode are only copied once, the rest of the links are recreated at the destination
+	void setPreserveHardlinks(bool preserve);
+	// If enabled, overwriting an existing file only rewrites the blocks that differ from the source
+	void setOverwriteChangedBlocksOnly(bool changedBlocksOnly);
 
 	bool togglePause();
 	bool paused()  const;
@@ -116,6 +120,9 @@ private:
 	NextAction copyItem(CFileSystemObject& item, const QFileInfo& destInfo, const QDir& destDir, uint64_t sizeProcessed, uint64_t totalSize, size_t currentItemIndex);
 	NextAction mkPath(const QDir& dir);
 
+	// Recreates the item as a hard link to the first copy of the same inode that has been written. Returns false if the item must be copied instead
+	bool linkToAlreadyCopiedInode(size_t itemIndex, const QFileInfo& destInfo);
+
 private:
 	std::vector<CFileSystemObject> _source;
 	std::map<HaltReason, UserResponse> _globalResponses;
@@ -127,6 +134,16 @@ private:
 	std::atomic<bool>              _finished;
 	std::atomic<bool>              _cancelRequested;
 	UserResponse                   _userResponse;
+	bool                           _preserveHardlinks;
+	bool                           _overwriteChangedBlocksOnly;
+	// Statistics for the overwrite mode that skips unchanged blocks
+	uint64_t                       _bytesComparedWhenOverwriting;
+	uint64_t                       _bytesWrittenWhenOverwriting;
+
+	// For each item in _source: the index of the first item sharing the same inode (the item's own index if it's the first one), or npos if the inode is not shared. Only filled in for copying and moving
+	std::vector<size_t>            _hardlinkOrigin;
+	// By the index of the first item sharing the inode: the first copy of the inode that has been written, which the rest of the links point to
+	std::map<size_t, QString>      _hardlinkDestPath;
 
 	std::thread                    _thread;
 	std::mutex                     _waitForResponseMutex;
@@ -67,8 +67,21 @@ inline QString fileSizeToString(uint64_t size, const char maxUnit = '\0', const
 	const unsigned int MB = 1024 * KB;
 	const unsigned int GB = 1024 * MB;
 
-	const std::map<char, unsigned int> unitCodes {{'B', 0}, {'K', KB}, {'M', MB}};
-	const unsigned int maxUnitSize = unitCodes.count(maxUnit) > 0 ? unitCodes.at(maxUnit) : std::numeric_limits<unsigned int>::max();
+	unsigned int maxUnitSize = std::numeric_limits<unsigned int>::max();
+	switch (maxUnit)
+	{
+	case 'B':
+		maxUnitSize = 0;
+		break;
+	case 'K':
+		maxUnitSize = KB;
+		break;
+	case 'M':
+		maxUnitSize = MB;
+		break;
+	default:
+		break;
+	}
 
 	QString str;
 	float n = 0.0f;
@@ -9,25 +9,31 @@ DISABLE_COMPILER_WARNINGS
 RESTORE_COMPILER_WARNINGS
 
 std::unique_ptr<CIconProvider> CIconProvider::_instance;
+std::mutex CIconProvider::_instanceMutex;
 
-const QIcon& CIconProvider::iconForFilesystemObject(const CFileSystemObject &object)
+// Can be called from any thread
+CIconProvider::IconSource CIconProvider::iconSourceForFilesystemObject(const CFileSystemObject& object)
 {
-	if (!_instance)
-	{
-		_instance = std::unique_ptr<CIconProvider>(new CIconProvider);
-		settingsChanged();
-	}
+	return instance()._provider->iconSourceFor(object);
+}
 
-	return _instance->iconFor(object);
+const QIcon& CIconProvider::iconFromSource(const IconSource& source)
+{
+	return instance().iconFor(source);
+}
+
+const QIcon& CIconProvider::iconForFilesystemObject(const CFileSystemObject &object)
+{
+	return iconFromSource(iconSourceForFilesystemObject(object));
 }
 
 void CIconProvider::settingsChanged()
 {
+	std::lock_guard<std::mutex> lock(_instanceMutex);
 	if (_instance && _instance->_provider)
 	{
 		_instance->_provider->settingsChanged();
 		_instance->_iconCache.clear();
-		_instance->_iconForObject.clear();
 	}
 }
 
@@ -35,38 +41,39 @@ CIconProvider::CIconProvider() : _provider(new CIconProviderImpl)
 {
 }
 
-inline static qulonglong hash(const CFileSystemObject& object)
+CIconProvider& CIconProvider::instance()
 {
-	const auto properties = object.properties();
-	const auto hashData = QByteArray::fromRawData((const char*)&properties.hash, sizeof(properties.hash)) +
-			QByteArray::fromRawData((const char*)&properties.modificationDate, sizeof(properties.modificationDate)) +
-			QByteArray::fromRawData((const char*)&properties.type, sizeof(properties.type));
+	std::lock_guard<std::mutex> lock(_instanceMutex);
+	if (!_instance)
+	{
+		_instance = std::unique_ptr<CIconProvider>(new CIconProvider);
+		_instance->_provider->settingsChanged();
+	}
 
-	return fasthash64(hashData.constData(), hashData.size(), 0);
+	return *_instance;
 }
 
-const QIcon& CIconProvider::iconFor(const CFileSystemObject& object)
+inline static qulonglong hash(const CIconProvider::IconSource& source)
 {
-	const qulonglong objectHash = hash(object);
-	if (_iconForObject.count(objectHash) == 0)
-	{
-		const QIcon icon = _provider->iconFor(object);
-		assert_r(!icon.isNull());
+	if (!source.image.isNull())
+		return fasthash64((const char*)source.image.constBits(), (size_t)source.image.bytesPerLine() * (size_t)source.image.height(), 0);
 
-		const auto qimage = icon.pixmap(icon.availableSizes().front()).toImage();
-		const qulonglong iconHash = fasthash64((const char*)qimage.constBits(), qimage.bytesPerLine() * qimage.height(), 0);
+	const QByteArray typeKey = source.typeKey.toUtf8() + (source.isDir ? "/" : "");
+	return fasthash64(typeKey.constData(), (size_t)typeKey.size(), 1);
+}
 
-		if (_iconCache.size() > 300)
-		{
-			_iconCache.clear();
-			_iconForObject.clear();
-		}
+const QIcon& CIconProvider::iconFor(const IconSource& source)
+{
+	const qulonglong sourceHash = hash(source);
+	const auto cachedIcon = _iconCache.find(sourceHash);
+	if (cachedIcon != _iconCache.end())
+		return cachedIcon->second;
 
-		const auto iconInContainer = _iconCache.insert(std::make_pair(iconHash, icon)).first;
-		_iconForObject[objectHash] = iconHash;
-		
-		return iconInContainer->second;
-	}
+	const QIcon icon = _provider->iconFromSource(source);
+	assert_r(!icon.isNull());
+
+	if (_iconCache.size() > 300)
+		_iconCache.clear();
 
-	return _iconCache[_iconForObject[objectHash]];
+	return _iconCache.insert(std::make_pair(sourceHash, icon)).first->second;
 }
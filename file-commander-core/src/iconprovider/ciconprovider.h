@@ -5,10 +5,12 @@
 
 DISABLE_COMPILER_WARNINGS
 #include <QIcon>
+#include <QImage>
 RESTORE_COMPILER_WARNINGS
 
 #include <unordered_map>
 #include <memory>
+#include <mutex>
 
 class CFileSystemObject;
 class CIconProviderImpl;
@@ -18,18 +20,31 @@ class CIconProviderImpl;
 class CIconProvider
 {
 public:
+	// What the icon of an object is made from. Finding it out is the slow part (file system access, MIME type sniffing), so it's done separately from creating the icon.
+	struct IconSource
+	{
+		QString typeKey; // The type of the object, for the icons that only depend on it
+		QImage  image;   // The icon of this particular object, where the platform provides one
+		bool    isDir = false;
+	};
+
+	// Can be called from any thread
+	static IconSource iconSourceForFilesystemObject(const CFileSystemObject& object);
+	// QIcon and QPixmap may only be created on the UI thread, so these two must only be called on the UI thread
+	static const QIcon& iconFromSource(const IconSource& source);
 	static const QIcon& iconForFilesystemObject(const CFileSystemObject& object);
 	static void settingsChanged();
 
 private:
 	CIconProvider();
-	const QIcon& iconFor(const CFileSystemObject& object);
+	static CIconProvider& instance();
+	const QIcon& iconFor(const IconSource& source);
 
 private:
 	static std::unique_ptr<CIconProvider> _instance;
+	static std::mutex _instanceMutex; // Only guards the creation of the instance, the icon cache is only accessed on the UI thread
 
-	std::unordered_map<qulonglong, QIcon> _iconCache;
-	std::unordered_map<qulonglong, qulonglong> _iconForObject;
+	std::unordered_map<qulonglong, QIcon> _iconCache; // By the hash of the icon source
 
 	std::unique_ptr<CIconProviderImpl> _provider;
 };
@@ -1,16 +1,20 @@
 #pragma once
 
+#include "ciconprovider.h"
 #include "settings.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 
 DISABLE_COMPILER_WARNINGS
 #ifdef _WIN32
 #include <QtWin>
 #else
-#include <QFileIconProvider>
+#include <QMimeDatabase>
 #endif
+#include <QFileIconProvider>
 RESTORE_COMPILER_WARNINGS
 
+#include <atomic>
+
 #ifdef _WIN32
 
 #include <shellapi.h>
@@ -18,9 +22,16 @@ RESTORE_COMPILER_WARNINGS
 class CIconProviderImpl
 {
 public:
-	inline QIcon iconFor(const CFileSystemObject& object)
+	// Can be called from any thread
+	inline CIconProvider::IconSource iconSourceFor(const CFileSystemObject& object)
 	{
-		QIcon icon;
+		// The shell functions need COM on the calling thread
+		static thread_local const HRESULT comInitialized = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+		(void)comInitialized;
+
+		CIconProvider::IconSource source;
+		source.isDir = object.isDir();
+
 		SHFILEINFO info;
 		memset(&info, 0, sizeof(info));
 		SHGetFileInfoW((WCHAR*)object.fullAbsolutePath().replace('/', '\\').utf16(), object.isDir() ? FILE_ATTRIBUTE_DIRECTORY : 0, &info, sizeof(SHFILEINFO),
@@ -28,21 +39,31 @@ public:
 
 		if (info.hIcon)
 		{
-			icon = QIcon(QtWin::fromHICON(info.hIcon));
+			// Unlike QPixmap, QImage can be created on any thread
+			source.image = QtWin::imageFromHICON(info.hIcon);
 			DestroyIcon(info.hIcon);
 		}
 
-		auto sizes = icon.availableSizes();
-		return icon;
+		return source;
+	}
+
+	// UI thread only
+	inline QIcon iconFromSource(const CIconProvider::IconSource& source)
+	{
+		if (!source.image.isNull())
+			return QIcon(QPixmap::fromImage(source.image));
+
+		return _provider.icon(source.isDir ? QFileIconProvider::Folder : QFileIconProvider::File);
 	}
 
 	inline void settingsChanged()
 	{
-		_showOverlayIcons = CSettings().value(KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS, false).toBool();
+		_showOverlayIcons = CSettingsStore::get().value(KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS, false).toBool();
 	}
 
 private:
-	bool _showOverlayIcons = false;
+	std::atomic<bool> _showOverlayIcons {false};
+	QFileIconProvider _provider;
 };
 
 #else
@@ -50,14 +71,34 @@ private:
 class CIconProviderImpl
 {
 public:
-	inline QIcon iconFor(const CFileSystemObject& object)
+	// Can be called from any thread: QMimeDatabase is thread-safe
+	inline CIconProvider::IconSource iconSourceFor(const CFileSystemObject& object)
 	{
-		return _provider.icon(object.qFileInfo());
+		CIconProvider::IconSource source;
+		source.isDir = object.isDir();
+		if (!source.isDir)
+			source.typeKey = QMimeDatabase().mimeTypeForFile(object.qFileInfo()).name();
+
+		return source;
+	}
+
+	// UI thread only: the icon theme is looked up the same way QFileIconProvider does, but by the type found by iconSourceFor()
+	inline QIcon iconFromSource(const CIconProvider::IconSource& source)
+	{
+		if (source.isDir)
+			return _provider.icon(QFileIconProvider::Folder);
+
+		const QMimeType mimeType = QMimeDatabase().mimeTypeForName(source.typeKey);
+		QIcon icon = QIcon::fromTheme(mimeType.iconName());
+		if (icon.isNull())
+			icon = QIcon::fromTheme(mimeType.genericIconName());
+
+		return icon.isNull() ? _provider.icon(QFileIconProvider::File) : icon;
 	}
 
 	inline void settingsChanged()
 	{
-		_showOverlayIcons = CSettings().value(KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS, false).toBool();
+		_showOverlayIcons = CSettingsStore::get().value(KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS, false).toBool();
 
 		const auto oldOptions = _provider.options();
 		const auto newOptions = _showOverlayIcons ? QFlags<QFileIconProvider::Option>() : QFileIconProvider::DontUseCustomDirectoryIcons;
@@ -71,4 +112,3 @@ private:
 };
 
 #endif
-
@@ -0,0 +1,173 @@
+#include "clistingcache.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDateTime>
+RESTORE_COMPILER_WARNINGS
+
+#include <chrono>
+
+#if defined __linux__ || defined __APPLE__
+#include <sys/stat.h>
+#endif
+
+static const size_t listingCacheMemoryBudget = 32 * 1024 * 1024;
+
+CListingCache& CListingCache::get()
+{
+	static CListingCache instance(listingCacheMemoryBudget);
+	return instance;
+}
+
+// Must be taken before enumerating the folder, so that changes made during the enumeration invalidate the listing
+CListingCache::DirectoryStamp CListingCache::directoryStamp(const QString& path)
+{
+	DirectoryStamp stamp;
+	stamp.takenAt = now();
+
+#if defined __linux__ || defined __APPLE__
+	struct stat info;
+	if (stat(path.toUtf8().constData(), &info) == 0)
+	{
+#ifdef __APPLE__
+		const timespec& modificationTime = info.st_mtimespec;
+#else
+		const timespec& modificationTime = info.st_mtim;
+#endif
+		stamp.modificationTime = (int64_t)modificationTime.tv_sec * 1000000000 + (int64_t)modificationTime.tv_nsec;
+		stamp.inode = (uint64_t)info.st_ino;
+		stamp.device = (uint64_t)info.st_dev;
+	}
+#else
+	const QFileInfo info(path);
+	if (info.exists())
+		stamp.modificationTime = info.lastModified().toMSecsSinceEpoch() * 1000000;
+#endif
+
+	return stamp;
+}
+
+// Steady clock ms, for comparing with DirectoryStamp::takenAt
+int64_t CListingCache::now()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CListingCache::CListingCache(size_t memoryBudget) : _memoryBudget(memoryBudget)
+{
+}
+
+// Replaces the previous listing of this folder, if any
+void CListingCache::insert(const QString& path, const DirectoryStamp& stamp, const Listing& listing)
+{
+	if (!listing)
+		return;
+
+	const size_t size = estimatedSize(*listing);
+	if (size > _memoryBudget)
+		return;
+
+	std::lock_guard<std::mutex> locker(_mutex);
+
+	const auto existingEntry = _entryByPath.find(path);
+	if (existingEntry != _entryByPath.end())
+	{
+		// Two panels may be listing the same folder at the same time, the latest state wins
+		if (existingEntry->second->stamp.takenAt > stamp.takenAt)
+			return;
+
+		remove(existingEntry->second);
+	}
+
+	while (!_entries.empty() && _memoryUsed + size > _memoryBudget)
+		remove(std::prev(_entries.end()));
+
+	_entries.push_front(Entry{path, stamp, listing, size});
+	_entryByPath[path] = _entries.begin();
+	_memoryUsed += size;
+}
+
+bool CListingCache::enumerate(const QString& path, int64_t notStartedBefore, const std::function<Listing ()>& enumerator, Listing& listing, const ListingHandler& onJoinedEnumerationDone)
+{
+	const auto enumeration = std::make_shared<Enumeration>();
+	{
+		std::lock_guard<std::mutex> locker(_mutex);
+		const auto inProgress = _enumerationsInProgress.find(path);
+		if (inProgress != _enumerationsInProgress.end() && inProgress->second->startedAt >= notStartedBefore)
+		{
+			inProgress->second->joinedHandlers.push_back(onJoinedEnumerationDone);
+			return false;
+		}
+
+		// An older enumeration of this folder, if any, still completes, but is no longer joined
+		enumeration->startedAt = now();
+		_enumerationsInProgress[path] = enumeration;
+	}
+
+	const DirectoryStamp stamp = directoryStamp(path);
+	listing = enumerator();
+
+	std::vector<ListingHandler> joinedHandlers;
+	{
+		std::lock_guard<std::mutex> locker(_mutex);
+		joinedHandlers.swap(enumeration->joinedHandlers);
+
+		const auto inProgress = _enumerationsInProgress.find(path);
+		if (inProgress != _enumerationsInProgress.end() && inProgress->second == enumeration)
+			_enumerationsInProgress.erase(inProgress);
+	}
+
+	// An empty listing means the folder could not be read, that's not worth caching
+	if (listing && !listing->empty())
+		insert(path, stamp, listing);
+
+	for (const ListingHandler& handler: joinedHandlers)
+		handler(listing);
+
+	return true;
+}
+
+// Returns the listing along with the folder stamp it was made at, or an empty listing if the folder is not in the cache
+CListingCache::Listing CListingCache::find(const QString& path, DirectoryStamp& stamp)
+{
+	std::lock_guard<std::mutex> locker(_mutex);
+
+	const auto entry = _entryByPath.find(path);
+	if (entry == _entryByPath.end())
+		return Listing();
+
+	_entries.splice(_entries.begin(), _entries, entry->second); // Iterators stay valid
+	stamp = entry->second->stamp;
+	return entry->second->listing;
+}
+
+bool CListingCache::contains(const QString& path) const
+{
+	std::lock_guard<std::mutex> locker(_mutex);
+	return _entryByPath.count(path) != 0;
+}
+
+void CListingCache::clear()
+{
+	std::lock_guard<std::mutex> locker(_mutex);
+	_entries.clear();
+	_entryByPath.clear();
+	_memoryUsed = 0;
+}
+
+// A rough estimate of the memory occupied by the listing
+size_t CListingCache::estimatedSize(const std::vector<CFileSystemObject>& listing)
+{
+	// The path is stored, in one form or another, in the properties and in the QFileInfo and QDir private data, and then there are the allocation overheads
+	size_t size = sizeof(listing) + listing.capacity() * sizeof(CFileSystemObject);
+	for (const auto& object: listing)
+		size += 512 + 6 * sizeof(QChar) * (size_t)object.properties().fullPath.size();
+
+	return size;
+}
+
+void CListingCache::remove(std::list<Entry>::iterator entry)
+{
+	_memoryUsed -= entry->size;
+	_entryByPath.erase(entry->path);
+	_entries.erase(entry);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "cfilesystemobject.h"
+
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+// Recently enumerated folders, shared by both panels and the prefetcher. The least recently used listings go first once the memory budget is exceeded. Thread-safe.
+class CListingCache
+{
+public:
+	typedef std::shared_ptr<const std::vector<CFileSystemObject>> Listing;
+
+	// Identifies the state of a folder's entries. A different stamp means the listing is outdated, but the same one doesn't prove it's current: the folder's time stamp has a limited resolution,
+	// and it doesn't change when a file in the folder only changes its size or date. A cached listing with a matching stamp is only good for displaying while the folder is re-read.
+	struct DirectoryStamp
+	{
+		int64_t  modificationTime = -1; // ns
+		uint64_t inode = 0; // The folder may have been deleted and re-created in the same place; not available on Windows
+		uint64_t device = 0;
+		int64_t  takenAt = 0; // Steady clock ms, not a part of the folder state
+
+		bool operator==(const DirectoryStamp& other) const {return modificationTime == other.modificationTime && inode == other.inode && device == other.device;}
+		bool operator!=(const DirectoryStamp& other) const {return !(*this == other);}
+	};
+
+	static CListingCache& get();
+
+	// Must be taken before enumerating the folder, so that changes made during the enumeration invalidate the listing
+	static DirectoryStamp directoryStamp(const QString& path);
+	// Steady clock ms, for comparing with DirectoryStamp::takenAt
+	static int64_t now();
+
+	explicit CListingCache(size_t memoryBudget);
+
+	// Replaces the previous listing of this folder, if any
+	void insert(const QString& path, const DirectoryStamp& stamp, const Listing& listing);
+	typedef std::function<void (const Listing&)> ListingHandler;
+	// Takes the folder stamp, calls the enumerator, caches the listing it returns and stores it into listing; returns true. If the folder is already being enumerated by another thread, and that enumeration
+	// has started no earlier than notStartedBefore (now() ms), returns false right away instead, and its listing is passed to onJoinedEnumerationDone on that thread once it's ready,
+	// so that e. g. both panels refreshing the same folder read it once without either of them blocking a thread. The enumerator returns an empty pointer to abandon the enumeration, and so the handlers receive it.
+	bool enumerate(const QString& path, int64_t notStartedBefore, const std::function<Listing ()>& enumerator, Listing& listing, const ListingHandler& onJoinedEnumerationDone);
+	// Returns the listing along with the folder stamp it was made at, or an empty listing if the folder is not in the cache
+	Listing find(const QString& path, DirectoryStamp& stamp);
+	bool contains(const QString& path) const;
+
+	void clear();
+
+private:
+	// Entries are keyed by the path as is: the objects carry the path the folder was listed by, so a listing can't be served for an alias of the folder anyway
+	struct Entry
+	{
+		QString        path;
+		DirectoryStamp stamp;
+		Listing        listing;
+		size_t         size;
+	};
+
+	struct Enumeration
+	{
+		int64_t                     startedAt = 0;
+		std::vector<ListingHandler> joinedHandlers;
+	};
+
+	// A rough estimate of the memory occupied by the listing
+	static size_t estimatedSize(const std::vector<CFileSystemObject>& listing);
+
+	void remove(std::list<Entry>::iterator entry);
+
+private:
+	const size_t                                       _memoryBudget;
+	size_t                                             _memoryUsed = 0;
+	std::list<Entry>                                   _entries; // Most recently used first
+	std::map<QString, std::list<Entry>::iterator>      _entryByPath;
+	std::map<QString, std::shared_ptr<Enumeration>>   _enumerationsInProgress; // By path, the latest one for each folder
+	mutable std::mutex                                 _mutex;
+};
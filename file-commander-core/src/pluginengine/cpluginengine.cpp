@@ -8,7 +8,12 @@ DISABLE_COMPILER_WARNINGS
 #include <QApplication>
 #include <QDebug>
 #include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QLibrary>
+#include <QMimeDatabase>
 RESTORE_COMPILER_WARNINGS
 
 CPluginEngine::CPluginEngine()
@@ -46,22 +51,24 @@ void CPluginEngine::loadPlugins()
 		if (path.isSymLink())
 			continue;
 
-		auto pluginModule = std::make_shared<QLibrary>(path.absoluteFilePath());
-		CreatePluginFunc createFunc = (CreatePluginFunc)pluginModule->resolve("createPlugin");
-		if (createFunc)
+		PluginEntry entry;
+		entry.libraryPath = path.absoluteFilePath();
+
+		// The manifest is named after the library without the platform-specific prefix and extension, e. g. plugin_textviewer.json for libplugin_textviewer.so
+		QString pluginName = path.fileName();
+		pluginName = pluginName.mid(pluginName.indexOf("plugin_"));
+		pluginName.truncate(pluginName.indexOf(pluginExtension));
+		if (readManifest(fileCommanderDir.absoluteFilePath(pluginName + ".json"), entry) && entry.type != CFileCommanderPlugin::Tool)
 		{
-			CFileCommanderPlugin * plugin = createFunc();
-			if (plugin)
-			{
-				plugin->setProxy(&CController::get().pluginProxy());
-				qDebug() << QString("Loaded plugin \"%1\" (%2)").arg(plugin->name()).arg(path.fileName());
-				_plugins.emplace_back(std::make_pair(std::shared_ptr<CFileCommanderPlugin>(plugin), pluginModule));
-			}
+			qDebug() << QString("Found plugin \"%1\" (%2), will be loaded when needed").arg(entry.name).arg(path.fileName());
+			_plugins.push_back(entry);
 		}
+		else if (loadPlugin(entry))
+			_plugins.push_back(entry);
 	}
 }
 
-const std::vector<std::pair<std::shared_ptr<CFileCommanderPlugin>, std::shared_ptr<QLibrary> > >& CPluginEngine::plugins() const
+const std::vector<CPluginEngine::PluginEntry>& CPluginEngine::plugins() const
 {
 	return _plugins;
 }
@@ -71,17 +78,18 @@ void CPluginEngine::panelContentsChanged(Panel p, FileListRefreshCause /*operati
 	CController& controller = CController::get();
 
 	auto& proxy = CController::get().pluginProxy();
-	proxy.panelContentsChanged(pluginPanelEnumFromCorePanelEnum(p), controller.panel(p).currentDirName(), controller.panel(p).list());
+	const auto snapshot = controller.panel(p).snapshot();
+	proxy.panelContentsChanged(pluginPanelEnumFromCorePanelEnum(p), controller.panel(p).currentDirName(), snapshot->items());
 }
 
 void CPluginEngine::itemDiscoveryInProgress(Panel /*p*/, qulonglong /*itemHash*/, size_t /*progress*/, const QString& /*currentDir*/)
 {
 }
 
-void CPluginEngine::selectionChanged(Panel p, const std::vector<qulonglong>& selectedItemsHashes)
+void CPluginEngine::selectionChanged(Panel p, const PanelState::SelectedItemsHashesSource& selectedItemsHashesSource)
 {
 	auto& proxy = CController::get().pluginProxy();
-	proxy.selectionChanged(pluginPanelEnumFromCorePanelEnum(p), selectedItemsHashes);
+	proxy.selectionChanged(pluginPanelEnumFromCorePanelEnum(p), selectedItemsHashesSource);
 }
 
 void CPluginEngine::currentItemChanged(Panel p, qulonglong currentItemHash)
@@ -133,11 +141,19 @@ PanelPosition CPluginEngine::pluginPanelEnumFromCorePanelEnum(Panel p)
 
 CFileCommanderViewerPlugin *CPluginEngine::viewerForCurrentFile()
 {
-	for(auto& plugin: _plugins)
+	const QString currentItemPath = CController::get().pluginProxy().currentItemPath();
+	for(auto& entry: _plugins)
 	{
-		if (plugin.first->type() == CFileCommanderPlugin::Viewer)
+		if (entry.type != CFileCommanderPlugin::Viewer)
+			continue;
+
+		// Only the viewers that may be able to handle the file are loaded to ask them
+		if (!entry.plugin && (!manifestMatchesFile(entry, currentItemPath) || !loadPlugin(entry)))
+			continue;
+
+		if (entry.plugin->type() == CFileCommanderPlugin::Viewer)
 		{
-			CFileCommanderViewerPlugin * viewer = static_cast<CFileCommanderViewerPlugin*>(plugin.first.get());
+			CFileCommanderViewerPlugin * viewer = static_cast<CFileCommanderViewerPlugin*>(entry.plugin.get());
 			assert_r(viewer);
 			if (viewer && viewer->canViewCurrentFile())
 				return viewer;
@@ -147,6 +163,106 @@ CFileCommanderViewerPlugin *CPluginEngine::viewerForCurrentFile()
 	return nullptr;
 }
 
+// Fills the entry from the manifest, returns false if there's no manifest or it's invalid
+bool CPluginEngine::readManifest(const QString& manifestPath, PluginEntry& entry)
+{
+	QFile manifestFile(manifestPath);
+	if (!manifestFile.open(QFile::ReadOnly))
+		return false;
+
+	QJsonParseError error;
+	const QJsonDocument manifest = QJsonDocument::fromJson(manifestFile.readAll(), &error);
+	if (error.error != QJsonParseError::NoError || !manifest.isObject())
+	{
+		qDebug() << "Invalid plugin manifest" << manifestPath << ":" << error.errorString();
+		return false;
+	}
+
+	const QJsonObject root = manifest.object();
+	entry.name = root.value("name").toString();
+
+	const QString type = root.value("type").toString();
+	if (type == "Viewer")
+		entry.type = CFileCommanderPlugin::Viewer;
+	else if (type == "Archive")
+		entry.type = CFileCommanderPlugin::Archive;
+	else if (type == "Tool")
+		entry.type = CFileCommanderPlugin::Tool;
+	else
+	{
+		qDebug() << "Unknown plugin type" << type << "in" << manifestPath;
+		return false;
+	}
+
+	for (const QJsonValue& extension: root.value("extensions").toArray())
+		entry.extensions.push_back(extension.toString().toLower());
+	for (const QJsonValue& mimeType: root.value("mimeTypes").toArray())
+		entry.mimeTypes.push_back(mimeType.toString());
+
+	return true;
+}
+
+// Checks the manifest to see if the plugin may be able to handle the file, without loading the plugin
+bool CPluginEngine::manifestMatchesFile(const PluginEntry& entry, const QString& filePath)
+{
+	if (filePath.isEmpty())
+		return false;
+
+	if (entry.extensions.contains("*") || entry.extensions.contains(QFileInfo(filePath).suffix().toLower()))
+		return true;
+
+	if (entry.mimeTypes.empty())
+		return false;
+
+	// Only the file name is looked at, the contents are left for the plugin itself
+	static const QMimeDatabase mimeDatabase;
+	const QMimeType mimeType = mimeDatabase.mimeTypeForFile(filePath, QMimeDatabase::MatchExtension);
+	for (const QString& handledType: entry.mimeTypes)
+	{
+		if (handledType.endsWith("/*") ? mimeType.name().startsWith(handledType.left(handledType.size() - 1)) : mimeType.inherits(handledType))
+			return true;
+	}
+
+	return false;
+}
+
+// Loads the library if it hasn't been loaded yet
+bool CPluginEngine::loadPlugin(PluginEntry& entry)
+{
+	if (entry.plugin)
+		return true;
+	else if (entry.loadingFailed)
+		return false;
+
+	auto pluginModule = std::make_shared<QLibrary>(entry.libraryPath);
+	CreatePluginFunc createFunc = (CreatePluginFunc)pluginModule->resolve("createPlugin");
+	if (!createFunc)
+	{
+		qDebug() << "Failed to load plugin" << entry.libraryPath << ":" << pluginModule->errorString();
+		entry.loadingFailed = true;
+		return false;
+	}
+
+	CFileCommanderPlugin * plugin = createFunc();
+	if (!plugin)
+	{
+		entry.loadingFailed = true;
+		return false;
+	}
+
+	plugin->setProxy(&CController::get().pluginProxy());
+	qDebug() << QString("Loaded plugin \"%1\" (%2)").arg(plugin->name()).arg(QFileInfo(entry.libraryPath).fileName());
+
+	entry.library = pluginModule;
+	entry.plugin.reset(plugin);
+	entry.name = plugin->name();
+	if (entry.type != plugin->type())
+		qDebug() << "The type of" << entry.name << "doesn't match its manifest";
+	entry.type = plugin->type();
+
+	return true;
+}
+
 void CPluginEngine::destroyAllPluginWindows()
 {
 	const auto tmpWindowsList = _activeWindows;
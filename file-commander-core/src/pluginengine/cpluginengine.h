@@ -4,6 +4,10 @@
 #include "cpanel.h"
 #include "plugininterface/cfilecommanderplugin.h"
 
+DISABLE_COMPILER_WARNINGS
+#include <QStringList>
+RESTORE_COMPILER_WARNINGS
+
 #include <vector>
 #include <memory>
 
@@ -15,10 +19,25 @@ class QLibrary;
 class CPluginEngine : public PanelContentsChangedListener
 {
 public:
+	// A plugin known from its manifest; the library is only loaded when the plugin is first needed
+	struct PluginEntry
+	{
+		QString                               libraryPath;
+		QString                               name;
+		CFileCommanderPlugin::PluginType      type = CFileCommanderPlugin::Viewer;
+		QStringList                           extensions; // Lower case, "*" matches any file
+		QStringList                           mimeTypes;  // "image/*" matches any image type
+		bool                                  loadingFailed = false; // Not trying again every time the plugin is needed
+
+		std::shared_ptr<QLibrary>             library;
+		std::shared_ptr<CFileCommanderPlugin> plugin; // Null until loaded
+	};
+
 	static CPluginEngine& get();
 
+	// Reads the plugin manifests. Only the plugins that don't have a manifest, and the tool plugins (which add their menu entries when loaded), are loaded right away.
 	void loadPlugins();
-	const std::vector<std::pair<std::shared_ptr<CFileCommanderPlugin>, std::shared_ptr<QLibrary> > >& plugins() const;
+	const std::vector<PluginEntry>& plugins() const;
 
 	void destroyAllPluginWindows();
 
@@ -26,7 +45,8 @@ public:
 	void panelContentsChanged(Panel p, FileListRefreshCause operation) override;
 	void itemDiscoveryInProgress(Panel p, qulonglong itemHash, size_t progress, const QString& currentDir) override;
 
-	void selectionChanged(Panel p, const std::vector<qulonglong>& selectedItemsHashes);
+	// The source is only called if a plugin asks for the selection
+	void selectionChanged(Panel p, const PanelState::SelectedItemsHashesSource& selectedItemsHashesSource);
 	void currentItemChanged(Panel p, qulonglong currentItemHash);
 	void currentPanelChanged(Panel p);
 
@@ -41,8 +61,15 @@ private:
 
 	CFileCommanderViewerPlugin * viewerForCurrentFile();
 
+	// Fills the entry from the manifest, returns false if there's no manifest or it's invalid
+	static bool readManifest(const QString& manifestPath, PluginEntry& entry);
+	// Checks the manifest to see if the plugin may be able to handle the file, without loading the plugin
+	static bool manifestMatchesFile(const PluginEntry& entry, const QString& filePath);
+	// Loads the library if it hasn't been loaded yet
+	bool loadPlugin(PluginEntry& entry);
+
 private:
-	std::vector<std::pair<std::shared_ptr<CFileCommanderPlugin>, std::shared_ptr<QLibrary>>> _plugins;
+	std::vector<PluginEntry> _plugins;
 	std::vector<CPluginWindow*> _activeWindows;
 };
 
@@ -25,10 +25,10 @@ void CPluginProxy::panelContentsChanged(PanelPosition panel, const QString &fold
 	state.currentFolder = folder;
 }
 
-void CPluginProxy::selectionChanged(PanelPosition panel, std::vector<qulonglong> selectedItemsHashes)
+void CPluginProxy::selectionChanged(PanelPosition panel, const PanelState::SelectedItemsHashesSource& selectedItemsHashesSource)
 {
 	PanelState& state = _panelState[panel];
-	state.selectedItemsHashes = selectedItemsHashes;
+	state.selectedItemsHashesSource = selectedItemsHashesSource;
 }
 
 void CPluginProxy::currentItemChanged(PanelPosition panel, qulonglong currentItemHash)
@@ -9,10 +9,15 @@
 
 
 struct PanelState {
+	typedef std::function<std::vector<qulonglong/*hash*/> ()> SelectedItemsHashesSource;
+
 	PanelState() : currentItemHash(0) {}
 
+	// The list is only built when asked for: the selection can be large and changes with every key press
+	std::vector<qulonglong/*hash*/> selectedItemsHashes() const {return selectedItemsHashesSource ? selectedItemsHashesSource() : std::vector<qulonglong>();}
+
 	std::map<qulonglong/*hash*/, CFileSystemObject> panelContents;
-	std::vector<qulonglong/*hash*/>                 selectedItemsHashes;
+	SelectedItemsHashesSource                       selectedItemsHashesSource;
 	qulonglong                                      currentItemHash;
 	QString                                         currentFolder;
 };
@@ -44,7 +49,7 @@ public:
 	void panelContentsChanged(PanelPosition panel, const QString& folder, const std::map<qulonglong /*hash*/, CFileSystemObject>& contents);
 
 // Events and data updates from UI
-	void selectionChanged(PanelPosition panel, std::vector<qulonglong/*hash*/> selectedItemsHashes);
+	void selectionChanged(PanelPosition panel, const PanelState::SelectedItemsHashesSource& selectedItemsHashesSource);
 	void currentItemChanged(PanelPosition panel, qulonglong currentItemHash);
 	void currentPanelChanged(PanelPosition panel);
 
@@ -0,0 +1,147 @@
+#include "csettingsstore.h"
+#include "settings/csettings.h"
+
+#include <algorithm>
+#include <vector>
+
+// A burst of changes (e. g. navigating through several folders) is written in one go once it's over, but no later than the maximum delay
+static const std::chrono::milliseconds writeDelay(500);
+static const std::chrono::milliseconds maxWriteDelay(3000);
+
+CSettingsStore& CSettingsStore::get()
+{
+	static CSettingsStore store;
+	return store;
+}
+
+CSettingsStore::CSettingsStore() : _writerThread(&CSettingsStore::writerThreadFunc, this)
+{
+}
+
+CSettingsStore::~CSettingsStore()
+{
+	{
+		std::lock_guard<std::mutex> locker(_mutex);
+		_terminate = true;
+	}
+
+	_changesPendingCondition.notify_one();
+	_writerThread.join();
+
+	flush();
+}
+
+QVariant CSettingsStore::value(const QString& key, const QVariant& defaultValue) const
+{
+	std::unique_lock<std::mutex> locker(_mutex);
+	auto it = _values.find(key);
+	if (it == _values.end())
+	{
+		// The first access reads the value from the disk, without blocking the other readers
+		locker.unlock();
+		const QVariant storedValue = CSettings().value(key);
+		locker.lock();
+		// Might have been set in the meantime, and the new value takes precedence
+		it = _values.emplace(key, storedValue).first;
+	}
+
+	return it->second.isValid() ? it->second : defaultValue;
+}
+
+void CSettingsStore::setValue(const QString& key, const QVariant& value)
+{
+	std::vector<ChangeListener> listeners;
+	{
+		std::lock_guard<std::mutex> locker(_mutex);
+		QVariant& currentValue = _values[key];
+		if (currentValue == value && currentValue.isValid())
+			return;
+
+		currentValue = value;
+		_pendingChanges[key] = value;
+
+		const auto now = std::chrono::steady_clock::now();
+		if (_pendingChanges.size() == 1)
+			_firstPendingChangeTime = now;
+		_lastChangeTime = now;
+
+		for (const auto& subscription: _subscriptions)
+		{
+			if (subscription.second.key == key)
+				listeners.push_back(subscription.second.listener);
+		}
+	}
+
+	_changesPendingCondition.notify_one();
+
+	for (const auto& listener: listeners)
+		listener(key, value);
+}
+
+// The listener is called on the thread that has changed the value, after the change. Returns the ID for unsubscribing.
+int CSettingsStore::subscribe(const QString& key, const ChangeListener& listener)
+{
+	std::lock_guard<std::mutex> locker(_mutex);
+	const int id = _nextSubscriptionId++;
+	_subscriptions[id] = Subscription{key, listener};
+	return id;
+}
+
+void CSettingsStore::unsubscribe(int subscriptionId)
+{
+	std::lock_guard<std::mutex> locker(_mutex);
+	_subscriptions.erase(subscriptionId);
+}
+
+// Writes the pending changes to the disk right away, e. g. before exiting
+void CSettingsStore::flush()
+{
+	std::lock_guard<std::mutex> writeLocker(_writeMutex);
+	writePendingChanges();
+}
+
+void CSettingsStore::writerThreadFunc()
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> locker(_mutex);
+			_changesPendingCondition.wait(locker, [this]() {return _terminate || !_pendingChanges.empty();});
+			if (_terminate)
+				return;
+
+			// Waiting for the burst of changes to end
+			for (;;)
+			{
+				const auto deadline = std::min(_lastChangeTime + writeDelay, _firstPendingChangeTime + maxWriteDelay);
+				if (_terminate || std::chrono::steady_clock::now() >= deadline)
+					break;
+
+				_changesPendingCondition.wait_until(locker, deadline);
+			}
+
+			if (_terminate)
+				return;
+		}
+
+		std::lock_guard<std::mutex> writeLocker(_writeMutex);
+		writePendingChanges();
+	}
+}
+
+// Must be called with _writeMutex locked, so that the batches are written in order
+void CSettingsStore::writePendingChanges()
+{
+	std::map<QString, QVariant> changes;
+	{
+		std::lock_guard<std::mutex> locker(_mutex);
+		changes.swap(_pendingChanges);
+	}
+
+	if (changes.empty())
+		return;
+
+	CSettings settings;
+	for (const auto& change: changes)
+		settings.setValue(change.first, change.second);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QString>
+#include <QVariant>
+RESTORE_COMPILER_WARNINGS
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// An in-memory copy of the settings. Values are read from CSettings once and then served from memory; changes take effect immediately
+// and are written to the disk in batches on a background thread, once there have been no further changes for a while. Thread-safe.
+class CSettingsStore
+{
+public:
+	typedef std::function<void (const QString& key, const QVariant& value)> ChangeListener;
+
+	static CSettingsStore& get();
+	~CSettingsStore();
+
+	QVariant value(const QString& key, const QVariant& defaultValue = QVariant()) const;
+	template <typename T>
+	T valueAs(const QString& key, const T& defaultValue) const
+	{
+		const QVariant v = value(key);
+		return v.isValid() && v.canConvert<T>() ? v.value<T>() : defaultValue;
+	}
+
+	void setValue(const QString& key, const QVariant& value);
+
+	// The listener is called on the thread that has changed the value, after the change. Returns the ID for unsubscribing.
+	int subscribe(const QString& key, const ChangeListener& listener);
+	void unsubscribe(int subscriptionId);
+
+	// Writes the pending changes to the disk right away, e. g. before exiting
+	void flush();
+
+private:
+	CSettingsStore();
+	CSettingsStore(const CSettingsStore&) = delete;
+	CSettingsStore& operator=(const CSettingsStore&) = delete;
+
+	void writerThreadFunc();
+	// Must be called with _writeMutex locked, so that the batches are written in order
+	void writePendingChanges();
+
+private:
+	struct Subscription
+	{
+		QString        key;
+		ChangeListener listener;
+	};
+
+	mutable std::map<QString, QVariant> _values; // An invalid value means the key isn't in the settings
+	std::map<QString, QVariant>         _pendingChanges;
+	std::map<int, Subscription>         _subscriptions;
+	int                                 _nextSubscriptionId = 0;
+	std::chrono::steady_clock::time_point _lastChangeTime;
+	std::chrono::steady_clock::time_point _firstPendingChangeTime;
+	bool                                _terminate = false;
+	mutable std::mutex                  _mutex;
+
+	std::mutex                          _writeMutex;
+	std::condition_variable             _changesPendingCondition;
+	std::thread                         _writerThread;
+};
@@ -1,5 +1,5 @@
 #include "cshell.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 #include "settings.h"
 #include "compiler/compiler_warnings_control.h"
 #include "assert/advanced_assert.h"
@@ -22,11 +22,11 @@ QString CShell::shellExecutable()
 {
 #ifdef _WIN32
 	static const QString defaultShell = QProcessEnvironment::systemEnvironment().value("ComSpec", "cmd.exe");
-	return CSettings().value(KEY_OTHER_SHELL_COMMAND_NAME, defaultShell).toString();
+	return CSettingsStore::get().value(KEY_OTHER_SHELL_COMMAND_NAME, defaultShell).toString();
 #elif defined __APPLE__
-	return CSettings().value(KEY_OTHER_SHELL_COMMAND_NAME, "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal").toString();
+	return CSettingsStore::get().value(KEY_OTHER_SHELL_COMMAND_NAME, "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal").toString();
 #elif defined __linux__
-	const QString consoleExecutable = CSettings().value(KEY_OTHER_SHELL_COMMAND_NAME).toString();
+	const QString consoleExecutable = CSettingsStore::get().value(KEY_OTHER_SHELL_COMMAND_NAME).toString();
 	if (QFileInfo(consoleExecutable).exists())
 		return consoleExecutable;
 
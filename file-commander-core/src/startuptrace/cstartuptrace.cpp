@@ -0,0 +1,50 @@
+#include "cstartuptrace.h"
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDebug>
+#include <QElapsedTimer>
+RESTORE_COMPILER_WARNINGS
+
+#include <mutex>
+#include <set>
+#include <stdint.h>
+#include <string>
+
+struct StartupTraceState
+{
+	QElapsedTimer         timer;
+	int64_t               previousMilestoneTime = 0;
+	std::set<std::string> milestonesReached;
+	std::mutex            mutex;
+};
+
+static StartupTraceState& startupTraceState()
+{
+	static StartupTraceState state;
+	return state;
+}
+
+// Starts the clock; the first milestone() starts it if this wasn't called
+void CStartupTrace::start()
+{
+	StartupTraceState& trace = startupTraceState();
+	std::lock_guard<std::mutex> locker(trace.mutex);
+	if (!trace.timer.isValid())
+		trace.timer.start();
+}
+
+// Each milestone is only logged the first time it's reached, so it can be reported from code that runs repeatedly
+void CStartupTrace::milestone(const char* phase)
+{
+	start();
+
+	StartupTraceState& trace = startupTraceState();
+	std::lock_guard<std::mutex> locker(trace.mutex);
+	if (!trace.milestonesReached.insert(phase).second)
+		return;
+
+	const int64_t now = trace.timer.elapsed();
+	qDebug() << "Startup:" << phase << "at" << now << "ms (+" << now - trace.previousMilestoneTime << "ms )";
+	trace.previousMilestoneTime = now;
+}
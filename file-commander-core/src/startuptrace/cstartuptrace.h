@@ -0,0 +1,11 @@
+#pragma once
+
+// Logs the time elapsed since the application start at each phase of the startup. Thread-safe.
+class CStartupTrace
+{
+public:
+	// Starts the clock; the first milestone() starts it if this wasn't called
+	static void start();
+	// Each milestone is only logged the first time it's reached, so it can be reported from code that runs repeatedly
+	static void milestone(const char* phase);
+};
@@ -0,0 +1,323 @@
+#include "ctaskscheduler.h"
+#include "assert/advanced_assert.h"
+
+#include <algorithm>
+#include <chrono>
+
+CCancellationToken::CCancellationToken() : _cancelled(std::make_shared<std::atomic<bool>>(false))
+{
+}
+
+void CCancellationToken::cancel()
+{
+	*_cancelled = true;
+}
+
+bool CCancellationToken::cancelled() const
+{
+	return *_cancelled;
+}
+
+static const size_t NotAWorkerThread = size_t(-1);
+static thread_local size_t currentWorkerIndex = NotAWorkerThread;
+
+// The number of threads is based on the number of hardware threads
+CTaskScheduler& CTaskScheduler::get()
+{
+	static CTaskScheduler scheduler(std::max<size_t>(2, std::thread::hardware_concurrency()));
+	return scheduler;
+}
+
+CTaskScheduler::CTaskScheduler(size_t numThreads)
+{
+	for (size_t i = 0; i < numThreads; ++i)
+		_workers.emplace_back(new Worker);
+
+	for (size_t i = 0; i < numThreads; ++i)
+		_workers[i]->thread = std::thread(&CTaskScheduler::workerThreadFunc, this, i);
+}
+
+CTaskScheduler::~CTaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> locker(_mutex);
+		_shutdown = true;
+	}
+
+	_wakeUpCondition.notify_all();
+	for (auto& worker: _workers)
+		worker->thread.join();
+}
+
+void CTaskScheduler::enqueue(const std::function<void()>& task, Lane lane)
+{
+	enqueueTask(Task{task, nullptr}, lane);
+}
+
+// The task is dropped if the token is cancelled before the task starts
+void CTaskScheduler::enqueue(const std::function<void()>& task, Lane lane, const CCancellationToken& token)
+{
+	enqueueTask(Task{task, token._cancelled}, lane);
+}
+
+// Runs the tasks in parallel and returns when all of them are done. The calling thread executes the tasks as well, so this can be called from a worker.
+void CTaskScheduler::parallelInvoke(const std::vector<std::function<void()>>& tasks, Lane lane)
+{
+	if (tasks.empty())
+		return;
+
+	struct Group
+	{
+		explicit Group(const std::vector<std::function<void()>>& tasks_) : tasks(tasks_), tasksRemaining(tasks_.size()) {}
+
+		// Claims and executes tasks until there are none left to claim
+		void run()
+		{
+			for (size_t i = nextTask++; i < tasks.size(); i = nextTask++)
+			{
+				tasks[i]();
+
+				std::lock_guard<std::mutex> locker(mutex);
+				if (--tasksRemaining == 0)
+					doneCondition.notify_all();
+			}
+		}
+
+		const std::vector<std::function<void()>> tasks;
+		std::atomic<size_t>     nextTask {0};
+		size_t                  tasksRemaining;
+		std::mutex              mutex;
+		std::condition_variable doneCondition;
+	};
+
+	// Helpers that start after all the tasks have been claimed simply exit; the group outlives them
+	const auto group = std::make_shared<Group>(tasks);
+	const size_t numHelpers = std::min(tasks.size() - 1, _workers.size());
+	for (size_t i = 0; i < numHelpers; ++i)
+		enqueue([group]() {group->run();}, lane);
+
+	group->run();
+
+	std::unique_lock<std::mutex> locker(group->mutex);
+	group->doneCondition.wait(locker, [&group]() {return group->tasksRemaining == 0;});
+}
+
+size_t CTaskScheduler::threadCount() const
+{
+	return _workers.size();
+}
+
+void CTaskScheduler::enqueueTask(Task&& task, Lane lane)
+{
+	assert_and_return_r(lane >= 0 && lane < LaneCount, );
+
+	if (currentWorkerIndex != NotAWorkerThread)
+	{
+		// Tasks queued by a worker are likely to use the data that's hot in its cache, so the worker picks them up first.
+		// The task is published and counted atomically, otherwise it could be stolen and claimed before it's counted. The locking order is the same as in takeTask().
+		Worker& worker = *_workers[currentWorkerIndex];
+		std::lock_guard<std::mutex> workerLocker(worker.mutex);
+		std::lock_guard<std::mutex> locker(_mutex);
+		worker.tasks[lane].push_back(std::move(task));
+		++_pendingTasks[lane];
+	}
+	else
+	{
+		std::lock_guard<std::mutex> locker(_mutex);
+		_tasks[lane].push_back(std::move(task));
+		++_pendingTasks[lane];
+	}
+
+	_wakeUpCondition.notify_one();
+}
+
+// Removes the task from the pending count and checks that the reserved worker is kept free; must be called with _mutex locked
+bool CTaskScheduler::claimTask(Lane lane)
+{
+	if (lane != InteractiveLane)
+	{
+		if (_runningNonInteractiveTasks + 1 >= _workers.size())
+			return false;
+
+		++_runningNonInteractiveTasks;
+	}
+
+	--_pendingTasks[lane];
+	return true;
+}
+
+// True if a worker has something to pick up; must be called with _mutex locked
+bool CTaskScheduler::canTakeTask() const
+{
+	if (_pendingTasks[InteractiveLane] > 0)
+		return true;
+
+	if (_runningNonInteractiveTasks + 1 >= _workers.size())
+		return false;
+
+	for (size_t lane = InteractiveLane + 1; lane < LaneCount; ++lane)
+		if (_pendingTasks[lane] > 0)
+			return true;
+
+	return false;
+}
+
+// Finds the highest priority task: in the worker's own queue, then in the shared queue, then in the other workers' queues.
+// Once a lane is held back by the reservation, so are all the following ones.
+bool CTaskScheduler::takeTask(size_t workerIndex, Task& task, Lane& lane)
+{
+	for (size_t laneIndex = 0; laneIndex < LaneCount; ++laneIndex)
+	{
+		lane = (Lane)laneIndex;
+		{
+			Worker& worker = *_workers[workerIndex];
+			std::lock_guard<std::mutex> locker(worker.mutex);
+			auto& queue = worker.tasks[lane];
+			if (!queue.empty())
+			{
+				std::lock_guard<std::mutex> pendingLocker(_mutex);
+				if (!claimTask(lane))
+					return false;
+
+				task = std::move(queue.back());
+				queue.pop_back();
+				return true;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> locker(_mutex);
+			auto& queue = _tasks[lane];
+			if (!queue.empty())
+			{
+				if (!claimTask(lane))
+					return false;
+
+				task = std::move(queue.front());
+				queue.pop_front();
+				return true;
+			}
+		}
+
+		for (size_t i = 1; i < _workers.size(); ++i)
+		{
+			Worker& victim = *_workers[(workerIndex + i) % _workers.size()];
+			std::lock_guard<std::mutex> locker(victim.mutex);
+			auto& queue = victim.tasks[lane];
+			if (!queue.empty())
+			{
+				std::lock_guard<std::mutex> pendingLocker(_mutex);
+				if (!claimTask(lane))
+					return false;
+
+				// Stealing the oldest task, the owner keeps working on the most recent ones
+				task = std::move(queue.front());
+				queue.pop_front();
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void CTaskScheduler::workerThreadFunc(size_t workerIndex)
+{
+	currentWorkerIndex = workerIndex;
+
+	for (;;)
+	{
+		Task task;
+		Lane lane = InteractiveLane;
+		if (takeTask(workerIndex, task, lane))
+		{
+			if (!task.cancelled || !*task.cancelled)
+				task.function();
+
+			if (lane != InteractiveLane)
+			{
+				{
+					std::lock_guard<std::mutex> locker(_mutex);
+					--_runningNonInteractiveTasks;
+				}
+
+				// A task that has been held back by the reservation may be taken now
+				_wakeUpCondition.notify_one();
+			}
+
+			continue;
+		}
+
+		std::unique_lock<std::mutex> locker(_mutex);
+		_wakeUpCondition.wait(locker, [this]() {return _shutdown || canTakeTask();});
+		if (_shutdown)
+			return; // The tasks that haven't started yet are abandoned
+	}
+}
+
+CTaskStrand::CTaskStrand(CTaskScheduler::Lane lane) : _state(std::make_shared<State>()), _lane(lane)
+{
+}
+
+// Cancels the tasks that haven't started yet and waits for the one in progress, if any, for a limited time
+CTaskStrand::~CTaskStrand()
+{
+	std::unique_lock<std::mutex> locker(_state->mutex);
+	_state->closed = true;
+	for (auto& task: _state->tasks)
+		task.second.cancel();
+	_state->tasks.clear();
+
+	// A task stuck on an unresponsive drive must not hold up the application exit, it's abandoned
+	_state->idleCondition.wait_for(locker, std::chrono::milliseconds(_destructionTimeout), [this]() {return !_state->running;});
+}
+
+void CTaskStrand::enqueue(const std::function<void()>& task)
+{
+	enqueue(task, CCancellationToken());
+}
+
+void CTaskStrand::enqueue(const std::function<void()>& task, const CCancellationToken& token)
+{
+	std::lock_guard<std::mutex> locker(_state->mutex);
+	assert_and_return_r(!_state->closed, );
+
+	_state->tasks.emplace_back(task, token);
+	if (!_state->running)
+	{
+		_state->running = true;
+		const auto state = _state;
+		const auto lane = _lane;
+		CTaskScheduler::get().enqueue([state, lane]() {runNextTask(state, lane);}, lane);
+	}
+}
+
+// Executes the next task of the strand, then queues itself again if there are more
+void CTaskStrand::runNextTask(const std::shared_ptr<State>& state, CTaskScheduler::Lane lane)
+{
+	std::unique_lock<std::mutex> locker(state->mutex);
+	while (!state->tasks.empty() && state->tasks.front().second.cancelled())
+		state->tasks.pop_front();
+
+	if (state->tasks.empty() || state->closed)
+	{
+		state->running = false;
+		state->idleCondition.notify_all();
+		return;
+	}
+
+	const auto task = state->tasks.front().first;
+	state->tasks.pop_front();
+	locker.unlock();
+
+	task();
+
+	locker.lock();
+	if (state->tasks.empty() || state->closed)
+	{
+		state->running = false;
+		state->idleCondition.notify_all();
+	}
+	else
+		CTaskScheduler::get().enqueue([state, lane]() {runNextTask(state, lane);}, lane); // Going through the scheduler again lets the higher priority work in
+}
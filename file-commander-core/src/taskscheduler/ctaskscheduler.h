@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A flag shared between the code that queues a task and the task itself. A task that is cancelled before it starts is dropped without running,
+// a running task may check cancelled() between units of work.
+class CCancellationToken
+{
+	friend class CTaskScheduler;
+public:
+	CCancellationToken();
+
+	void cancel();
+	bool cancelled() const;
+
+private:
+	std::shared_ptr<std::atomic<bool>> _cancelled;
+};
+
+// The process-wide thread pool for the core. Tasks are queued into priority lanes, and a worker always picks up the highest priority task available.
+// Each worker keeps the tasks it queues itself in a local queue; idle workers steal from the others before going to sleep.
+// Tasks can't be preempted, so one worker is reserved for the interactive lane: background and bulk I/O tasks never occupy all the workers at once.
+// Anything that may block indefinitely (e. g. waiting for the user) doesn't belong here at all and should get its own thread.
+class CTaskScheduler
+{
+public:
+	enum Lane {
+		InteractiveLane, // Listings and other work the user is waiting for
+		BackgroundLane,  // Statistics, icons and other work that can wait
+		BulkIoLane,      // Long-running file operations
+		LaneCount
+	};
+
+	// The number of threads is based on the number of hardware threads
+	static CTaskScheduler& get();
+	~CTaskScheduler();
+
+	void enqueue(const std::function<void()>& task, Lane lane = InteractiveLane);
+	// The task is dropped if the token is cancelled before the task starts
+	void enqueue(const std::function<void()>& task, Lane lane, const CCancellationToken& token);
+
+	// Runs the tasks in parallel and returns when all of them are done. The calling thread executes the tasks as well, so this can be called from a worker.
+	void parallelInvoke(const std::vector<std::function<void()>>& tasks, Lane lane = InteractiveLane);
+
+	size_t threadCount() const;
+
+private:
+	struct Task
+	{
+		std::function<void()> function;
+		std::shared_ptr<const std::atomic<bool>> cancelled;
+	};
+
+	struct Worker
+	{
+		std::mutex       mutex;
+		std::deque<Task> tasks[LaneCount];
+		std::thread      thread;
+	};
+
+	explicit CTaskScheduler(size_t numThreads);
+
+	void enqueueTask(Task&& task, Lane lane);
+	// Finds the highest priority task: in the worker's own queue, then in the shared queue, then in the other workers' queues
+	bool takeTask(size_t workerIndex, Task& task, Lane& lane);
+	// Removes the task from the pending count and checks that the reserved worker is kept free; must be called with _mutex locked
+	bool claimTask(Lane lane);
+	// True if a worker has something to pick up; must be called with _mutex locked
+	bool canTakeTask() const;
+	void workerThreadFunc(size_t workerIndex);
+
+private:
+	std::vector<std::unique_ptr<Worker>> _workers;
+
+	std::mutex              _mutex; // Guards the shared queues, the task counts and _shutdown
+	std::condition_variable _wakeUpCondition;
+	std::deque<Task>        _tasks[LaneCount]; // Tasks queued from outside the worker threads
+	size_t                  _pendingTasks[LaneCount] = {}; // In all the queues
+	size_t                  _runningNonInteractiveTasks = 0;
+	bool                    _shutdown = false;
+};
+
+// Executes tasks one at a time in the order they were queued, on the threads of CTaskScheduler. A panel queues all its work on the listing into
+// its own strand, so that the refreshes of the same panel never run concurrently.
+class CTaskStrand
+{
+public:
+	explicit CTaskStrand(CTaskScheduler::Lane lane);
+	// Cancels the tasks that haven't started yet and waits for the one in progress, if any, for a limited time
+	~CTaskStrand();
+
+	void enqueue(const std::function<void()>& task);
+	void enqueue(const std::function<void()>& task, const CCancellationToken& token);
+
+private:
+	struct State
+	{
+		std::mutex              mutex;
+		std::condition_variable idleCondition;
+		std::deque<std::pair<std::function<void()>, CCancellationToken>> tasks;
+		bool                    running = false;
+		bool                    closed = false;
+	};
+
+	// Executes the next task of the strand, then queues itself again if there are more
+	static void runNextTask(const std::shared_ptr<State>& state, CTaskScheduler::Lane lane);
+
+private:
+	const std::shared_ptr<State> _state;
+	const CTaskScheduler::Lane   _lane;
+
+	static const int             _destructionTimeout = 3000; // ms
+};
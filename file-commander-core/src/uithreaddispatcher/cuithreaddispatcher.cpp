@@ -0,0 +1,89 @@
+#include "cuithreaddispatcher.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QCoreApplication>
+#include <QEvent>
+RESTORE_COMPILER_WARNINGS
+
+#include <chrono>
+
+static const QEvent::Type WakeUpEvent = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+// The longest a single wakeup may keep the thread busy; the rest of the tasks go into the next event so that input and painting are not held up
+static const std::chrono::milliseconds MaxBatchDuration(16);
+
+// Can be called from any thread. A task with a tag other than NoTag replaces the pending task with the same tag and priority, if there is one
+void CUiThreadDispatcher::enqueue(const std::function<void()>& task, int tag, Priority priority)
+{
+	std::lock_guard<std::mutex> locker(_mutex);
+
+	auto& queue = _tasks[priority];
+	bool replaced = false;
+	if (tag != NoTag)
+	{
+		for (auto& pendingTask: queue)
+		{
+			if (pendingTask.tag == tag)
+			{
+				pendingTask.function = task;
+				replaced = true;
+				break;
+			}
+		}
+	}
+
+	if (!replaced)
+		queue.push_back(Task{task, tag});
+
+	if (!_wakeUpPosted)
+	{
+		_wakeUpPosted = true;
+		QCoreApplication::postEvent(this, new QEvent(WakeUpEvent));
+	}
+}
+
+// Executes all the pending tasks right away; must be called on the dispatcher's thread
+void CUiThreadDispatcher::processPendingTasks()
+{
+	for (auto task = takeNextTask(); task; task = takeNextTask())
+		task();
+}
+
+void CUiThreadDispatcher::customEvent(QEvent * e)
+{
+	if (e->type() != WakeUpEvent)
+	{
+		QObject::customEvent(e);
+		return;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	for (auto task = takeNextTask(); task; task = takeNextTask())
+	{
+		task();
+		if (std::chrono::steady_clock::now() - start >= MaxBatchDuration)
+		{
+			// _wakeUpPosted is still set since the queue isn't empty, so nobody else has posted an event
+			QCoreApplication::postEvent(this, new QEvent(WakeUpEvent));
+			return;
+		}
+	}
+}
+
+// Returns the highest priority pending task, or an empty function if there are none left
+std::function<void()> CUiThreadDispatcher::takeNextTask()
+{
+	std::lock_guard<std::mutex> locker(_mutex);
+	for (auto& queue: _tasks)
+	{
+		if (!queue.empty())
+		{
+			std::function<void()> task = std::move(queue.front().function);
+			queue.pop_front();
+			return task;
+		}
+	}
+
+	_wakeUpPosted = false;
+	return std::function<void()>();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QObject>
+RESTORE_COMPILER_WARNINGS
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Executes tasks on the thread it has been created on (normally the UI thread). Nothing is polled: the first task queued into an empty dispatcher
+// posts a single event to the thread's event loop, so an idle dispatcher never wakes the thread up.
+class CUiThreadDispatcher : public QObject
+{
+public:
+	enum Priority {
+		HighPriority,   // Results the user is waiting for, e. g. a new file list
+		NormalPriority,
+		LowPriority,    // Progress and other informational updates
+		PriorityCount
+	};
+
+	enum {NoTag = -1};
+
+	// Can be called from any thread. A task with a tag other than NoTag replaces the pending task with the same tag and priority, if there is one
+	void enqueue(const std::function<void()>& task, int tag = NoTag, Priority priority = NormalPriority);
+	// Executes all the pending tasks right away; must be called on the dispatcher's thread
+	void processPendingTasks();
+
+protected:
+	void customEvent(QEvent * e) override;
+
+private:
+	// Returns the highest priority pending task, or an empty function if there are none left
+	std::function<void()> takeNextTask();
+
+private:
+	struct Task
+	{
+		std::function<void()> function;
+		int tag;
+	};
+
+	std::mutex       _mutex;
+	std::deque<Task> _tasks[PriorityCount];
+	bool             _wakeUpPosted = false; // An event is on its way to the thread, no need to post another one
+};
@@ -1,6 +1,6 @@
 TEMPLATE = subdirs
 
-SUBDIRS += qtutils text_encoding_detector file_commander_core imageviewerplugin textviewerplugin qt_app cpputils
+SUBDIRS += qtutils text_encoding_detector file_commander_core imageviewerplugin textviewerplugin qt_app cpputils fileoperations_benchmark
 
 qtutils.subdir = qtutils
 qtutils.depends = cpputils
@@ -21,3 +21,6 @@ qt_app.subdir  = qt-app
 qt_app.depends = file_commander_core qtutils imageviewerplugin textviewerplugin
 
 cpputils.subdir = cpputils
+
+fileoperations_benchmark.subdir = benchmarks/fileoperations
+fileoperations_benchmark.depends = file_commander_core qtutils
@@ -19,6 +19,7 @@ msbuild ..\..\file-commander.sln /t:Rebuild /p:Configuration=Release;PlatformToo
 
 xcopy /R /Y ..\..\bin\FileCommander.exe binaries\32\
 xcopy /R /Y ..\..\bin\plugin_*.dll binaries\32\
+xcopy /R /Y ..\..\bin\plugin_*.json binaries\32\
 
 SETLOCAL
 SET PATH=%QTDIR32%\bin\
@@ -45,6 +46,7 @@ msbuild ..\..\file-commander.sln /t:Rebuild /p:Configuration=Release;PlatformToo
 
 xcopy /R /Y ..\..\bin\FileCommander.exe binaries\64\
 xcopy /R /Y ..\..\bin\plugin_*.dll binaries\64\
+xcopy /R /Y ..\..\bin\plugin_*.json binaries\64\
 
 SETLOCAL
 SET PATH=%QTDIR64%\bin\
@@ -69,6 +69,10 @@ FORMS += \
 	src/cimageviewerwidget.ui \
 	src/cimageviewerwindow.ui
 
+# The manifest lets the plugin engine know what the plugin handles without loading the library
+OTHER_FILES += plugin_imageviewer.json
+QMAKE_POST_LINK += $$QMAKE_COPY $$shell_path($$PWD/plugin_imageviewer.json) $$shell_path($$OUT_PWD/$$DESTDIR/)
+
 mac*|linux*{
 	PRE_TARGETDEPS += $${DESTDIR}/libcore.a
 }
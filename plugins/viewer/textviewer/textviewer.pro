@@ -69,6 +69,10 @@ FORMS += \
 RESOURCES += \
 	src/icons.qrc
 
+# The manifest lets the plugin engine know what the plugin handles without loading the library
+OTHER_FILES += plugin_textviewer.json
+QMAKE_POST_LINK += $$QMAKE_COPY $$shell_path($$PWD/plugin_textviewer.json) $$shell_path($$OUT_PWD/$$DESTDIR/)
+
 mac*|linux*{
 	PRE_TARGETDEPS += $${DESTDIR}/libcore.a $${DESTDIR}/libtext_encoding_detector.a
 }
@@ -32,6 +32,7 @@ SOURCES += \
 	src/panel/filelistwidget/model/cfilelistmodel.cpp \
 	src/panel/filelistwidget/cfilelistview.cpp \
 	src/panel/filelistwidget/model/cfilelistsortfilterproxymodel.cpp \
+	src/panel/filelistwidget/model/cfilelistfilterengine.cpp \
 	src/settings/csettingspageinterface.cpp \
 	src/settings/csettingspageedit.cpp \
 	src/settings/csettingspageother.cpp \
@@ -52,6 +53,7 @@ HEADERS += \
 	src/panel/columns.h \
 	src/panel/filelistwidget/cfilelistview.h \
 	src/panel/filelistwidget/model/cfilelistsortfilterproxymodel.h \
+	src/panel/filelistwidget/model/cfilelistfilterengine.h \
 	src/settings/csettingspageinterface.h \
 	src/settings/csettingspageedit.h \
 	src/settings/csettingspageother.h \
@@ -5,7 +5,7 @@
 #include "progressdialogs/cfileoperationconfirmationprompt.h"
 #include "ui_cmainwindow.h"
 #include "settings.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 #include "shell/cshell.h"
 #include "settingsui/csettingsdialog.h"
 #include "settings/csettingspageinterface.h"
@@ -17,6 +17,7 @@
 #include "panel/columns.h"
 #include "panel/cpanelwidget.h"
 #include "filesystemhelperfunctions.h"
+#include "startuptrace/cstartuptrace.h"
 #include "utils/utils.h"
 
 DISABLE_COMPILER_WARNINGS
@@ -35,6 +36,8 @@ RESTORE_COMPILER_WARNINGS
 #include <Windows.h>
 #endif
 
+#include <thread>
+
 // Main window settings keys
 #define KEY_RPANEL_STATE      "Ui/RPanel/State"
 #define KEY_LPANEL_STATE      "Ui/LPanel/State"
@@ -103,8 +106,7 @@ CMainWindow::CMainWindow(QWidget *parent) :
 	ui->leftWidget->setCurrentIndex(0); // PanelWidget
 	ui->rightWidget->setCurrentIndex(0); // PanelWidget
 
-	connect(&_uiThreadTimer, &QTimer::timeout, this, &CMainWindow::uiThreadTimerTick);
-	_uiThreadTimer.start(5);
+	CStartupTrace::milestone("main window created");
 }
 
 void CMainWindow::initButtons()
@@ -145,7 +147,7 @@ void CMainWindow::initActions()
 	connect(ui->actionOpen_Console_Here, &QAction::triggered, this, &CMainWindow::openTerminal);
 	connect(ui->actionExit, &QAction::triggered, qApp, &QApplication::quit);
 
-	ui->action_Show_hidden_files->setChecked(CSettings().value(KEY_INTERFACE_SHOW_HIDDEN_FILES, true).toBool());
+	ui->action_Show_hidden_files->setChecked(CSettingsStore::get().value(KEY_INTERFACE_SHOW_HIDDEN_FILES, true).toBool());
 	connect(ui->action_Show_hidden_files, &QAction::triggered, this, &CMainWindow::showHiddenFiles);
 	connect(ui->actionShowAllFiles, &QAction::triggered, this, &CMainWindow::showAllFilesFromCurrentFolderAndBelow);
 	connect(ui->action_Settings, &QAction::triggered, this, &CMainWindow::openSettingsDialog);
@@ -170,7 +172,7 @@ bool CMainWindow::copyFiles(const std::vector<CFileSystemObject> & files, const
 
 	const QString destPath = files.size() == 1 && files.front().isFile() ? cleanPath(destDir % toNativeSeparators("/") % files.front().fullName()) : destDir;
 	CFileOperationConfirmationPrompt prompt(tr("Copy files"), tr("Copy %1 %2 to").arg(files.size()).arg(files.size() > 1 ? "files" : "file"), destPath, this);
-	if (CSettings().value(KEY_OPERATIONS_ASK_FOR_COPY_MOVE_CONFIRMATION, true).toBool())
+	if (CSettingsStore::get().value(KEY_OPERATIONS_ASK_FOR_COPY_MOVE_CONFIRMATION, true).toBool())
 	{
 		if (prompt.exec() != QDialog::Accepted)
 			return false;
@@ -188,7 +190,7 @@ bool CMainWindow::moveFiles(const std::vector<CFileSystemObject> & files, const
 	if (files.empty() || destDir.isEmpty())
 		return false;
 
-	if (CSettings().value(KEY_OPERATIONS_ASK_FOR_COPY_MOVE_CONFIRMATION, true).toBool())
+	if (CSettingsStore::get().value(KEY_OPERATIONS_ASK_FOR_COPY_MOVE_CONFIRMATION, true).toBool())
 	{
 		CFileOperationConfirmationPrompt prompt(tr("Move files"), tr("Move %1 %2 to").arg(files.size()).arg(files.size() > 1 ? "files" : "file"), destDir, this);
 		if (prompt.exec() != QDialog::Accepted)
@@ -215,7 +217,7 @@ CMainWindow *CMainWindow::get()
 
 void CMainWindow::updateInterface()
 {
-	CSettings s;
+	CSettingsStore& s = CSettingsStore::get();
 	restoreGeometry(s.value(KEY_GEOMETRY).toByteArray());
 	restoreState(s.value(KEY_STATE).toByteArray());
 	ui->splitter->restoreState(s.value(KEY_SPLITTER_SIZES).toByteArray());
@@ -228,11 +230,15 @@ void CMainWindow::updateInterface()
 	ui->commandLine->lineEdit()->clear();
 
 	show();
+	CStartupTrace::milestone("main window shown");
+
+	// Queued behind the first paint
+	_controller->initialize();
 
 	if ((windowState() & Qt::WindowFullScreen) != 0)
 		ui->actionFull_screen_mode->setChecked(true);
 
-	Panel lastActivePanel = (Panel)CSettings().value(KEY_LAST_ACTIVE_PANEL, LeftPanel).toInt();
+	Panel lastActivePanel = (Panel)CSettingsStore::get().value(KEY_LAST_ACTIVE_PANEL, LeftPanel).toInt();
 	if (lastActivePanel == LeftPanel)
 		ui->leftPanel->setFocusToFileList();
 	else
@@ -243,7 +249,7 @@ void CMainWindow::closeEvent(QCloseEvent *e)
 {
 	if (e->type() == QCloseEvent::Close)
 	{
-		CSettings s;
+		CSettingsStore& s = CSettingsStore::get();
 		s.setValue(KEY_GEOMETRY, saveGeometry());
 		s.setValue(KEY_STATE, saveState());
 		s.setValue(KEY_SPLITTER_SIZES, ui->splitter->saveState());
@@ -302,7 +308,7 @@ void CMainWindow::currentPanelChanged(QStackedWidget *panel)
 	if (_currentFileList)
 	{
 		_controller->activePanelChanged(_currentFileList->panelPosition());
-		CSettings().setValue(KEY_LAST_ACTIVE_PANEL, _currentFileList->panelPosition());
+		CSettingsStore::get().setValue(KEY_LAST_ACTIVE_PANEL, _currentFileList->panelPosition());
 		ui->fullPath->setText(_controller->panel(_currentFileList->panelPosition()).currentDirPathNative());
 		CPluginEngine::get().currentPanelChanged(_currentFileList->panelPosition());
 		_commandLineCompleter.setModel(_currentFileList->sortModel());
@@ -311,12 +317,6 @@ void CMainWindow::currentPanelChanged(QStackedWidget *panel)
 		_commandLineCompleter.setModel(0);
 }
 
-void CMainWindow::uiThreadTimerTick()
-{
-	if (_controller)
-		_controller->uiThreadTimerTick();
-}
-
 bool CMainWindow::widgetBelongsToHierarchy(QWidget * const widget, QObject * const hierarchy)
 {
 	if (widget == hierarchy)
@@ -378,12 +378,13 @@ void CMainWindow::deleteFiles()
 	if (paths.empty())
 		return;
 
-	_controller->execOnWorkerThread([=]() {
+	// The shell shows its own confirmation and progress UI, which can take arbitrarily long; this would pin a scheduler worker
+	std::thread([=]() {
 		if (!CShell::deleteItems(paths, true, (void*) winId()))
 			_controller->execOnUiThread([this]() {
 				QMessageBox::warning(this, tr("Error deleting items"), tr("Failed to delete the selected items"));
 		});
-	});
+	}).detach();
 
 #else
 	deleteFilesIrrevocably();
@@ -403,12 +404,13 @@ void CMainWindow::deleteFilesIrrevocably()
 	for (auto& item: items)
 		paths.emplace_back(toNativeSeparators(item.fullAbsolutePath()).toStdWString());
 
-	_controller->execOnWorkerThread([=]() {
+	// The shell shows its own confirmation and progress UI, which can take arbitrarily long; this would pin a scheduler worker
+	std::thread([=]() {
 		if (!CShell::deleteItems(paths, false, (void*) winId()))
 			_controller->execOnUiThread([this]() {
 				QMessageBox::warning(this, tr("Error deleting items"), tr("Failed to delete the selected items"));
 		});
-	});
+	}).detach();
 #else
 	if (QMessageBox::question(this, tr("Are you sure?"), tr("Do you want to delete the selected files and folders completely?"), QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
 	{
@@ -463,7 +465,7 @@ void CMainWindow::viewFile()
 
 void CMainWindow::editFile()
 {
-	QString editorPath = CSettings().value(KEY_EDITOR_PATH).toString();
+	QString editorPath = CSettingsStore::get().value(KEY_EDITOR_PATH).toString();
 	if (editorPath.isEmpty() || !QFileInfo(editorPath).exists())
 	{
 		if (QMessageBox::question(this, tr("Editor not configured"), tr("No editor program has been configured (or the specified path doesn't exist). Do you want to specify the editor now?")) == QMessageBox::Yes)
@@ -477,7 +479,7 @@ void CMainWindow::editFile()
 			if (editorPath.isEmpty())
 				return;
 
-			CSettings().setValue(KEY_EDITOR_PATH, editorPath);
+			CSettingsStore::get().setValue(KEY_EDITOR_PATH, editorPath);
 		}
 		else
 			return;
@@ -486,14 +488,14 @@ void CMainWindow::editFile()
 	const QString currentFile = _currentFileList ? _controller->itemByHash(_currentFileList->panelPosition(), _currentFileList->currentItemHash()).fullAbsolutePath() : QString();
 	if (!currentFile.isEmpty())
 	{
-		const QString editorPath = CSettings().value(KEY_EDITOR_PATH).toString();
+		const QString editorPath = CSettingsStore::get().value(KEY_EDITOR_PATH).toString();
 		if (editorPath.isEmpty())
 			return;
 
 #ifdef __APPLE__
-		const bool started = std::system((QString("open \"") + CSettings().value(KEY_EDITOR_PATH).toString() + "\" --args \"" + currentFile + "\"").toUtf8().constData()) == 0;
+		const bool started = std::system((QString("open \"") + CSettingsStore::get().value(KEY_EDITOR_PATH).toString() + "\" --args \"" + currentFile + "\"").toUtf8().constData()) == 0;
 #else
-		const bool started = QProcess::startDetached(CSettings().value(KEY_EDITOR_PATH).toString(), QStringList() << currentFile);
+		const bool started = QProcess::startDetached(CSettingsStore::get().value(KEY_EDITOR_PATH).toString(), QStringList() << currentFile);
 #endif
 
 		if (!started)
@@ -550,7 +552,7 @@ bool CMainWindow::executeCommand(QString commandLineText)
 		return false;
 
 	CShell::executeShellCommand(commandLineText, _currentFileList->currentDir());
-	QTimer::singleShot(0, [=](){CSettings().setValue(KEY_LAST_COMMANDS_EXECUTED, ui->commandLine->items());}); // Saving the list AFTER the combobox actually accepts the newly added item
+	QTimer::singleShot(0, [=](){CSettingsStore::get().setValue(KEY_LAST_COMMANDS_EXECUTED, ui->commandLine->items());}); // Saving the list AFTER the combobox actually accepts the newly added item
 	clearCommandLineAndRestoreFocus();
 
 	return true;
@@ -596,7 +598,7 @@ void CMainWindow::refresh()
 
 void CMainWindow::showHiddenFiles()
 {
-	CSettings().setValue(KEY_INTERFACE_SHOW_HIDDEN_FILES, ui->action_Show_hidden_files->isChecked());
+	CSettingsStore::get().setValue(KEY_INTERFACE_SHOW_HIDDEN_FILES, ui->action_Show_hidden_files->isChecked());
 	_controller->refreshPanelContents(LeftPanel);
 	_controller->refreshPanelContents(RightPanel);
 }
@@ -1,6 +1,8 @@
 #include "cmainwindow.h"
 #include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 #include "iconprovider/ciconprovider.h"
+#include "startuptrace/cstartuptrace.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QApplication>
@@ -17,6 +19,8 @@ public:
 
 int main(int argc, char *argv[])
 {
+	CStartupTrace::start();
+
 	AdvancedAssert::setLoggingFunc([](const char* message){
 		qDebug() << message;
 	});
@@ -27,11 +31,14 @@ int main(int argc, char *argv[])
 
 	CSettings::setApplicationName(app.applicationName());
 	CSettings::setOrganizationName(app.organizationName());
+	CStartupTrace::milestone("application object created");
 
 	CMainWindow w;
 	w.updateInterface();
 
 	const int retCode = app.exec();
+	// Not leaving the last changes to the static destructors
+	CSettingsStore::get().flush();
 	return retCode;
 }
 
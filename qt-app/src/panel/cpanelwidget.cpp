@@ -10,9 +10,10 @@
 #include "../favoritelocationseditor/cfavoritelocationseditor.h"
 #include "widgets/clineedit.h"
 #include "filesystemhelperfunctions.h"
+#include "startuptrace/cstartuptrace.h"
 #include "progressdialogs/ccopymovedialog.h"
 #include "../cmainwindow.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 #include "settings.h"
 
 DISABLE_COMPILER_WARNINGS
@@ -22,13 +23,13 @@ DISABLE_COMPILER_WARNINGS
 #include <QMenu>
 #include <QMessageBox>
 #include <QMimeData>
+#include <QPointer>
 #include <QPushButton>
 #include <QWheelEvent>
 RESTORE_COMPILER_WARNINGS
 
+#include <thread>
 #include <time.h>
-#include <set>
-#include <tuple>
 
 CPanelWidget::CPanelWidget(QWidget *parent /* = 0 */) :
 	QWidget(parent),
@@ -51,6 +52,19 @@ CPanelWidget::CPanelWidget(QWidget *parent /* = 0 */) :
 	ui->_infoLabel->clear();
 	ui->_driveInfoLabel->clear();
 
+	// Shown while the panel is listing a large folder or calculating folder sizes
+	ui->_discoveryProgress->hide();
+	_discoveryProgressHideTimer.setSingleShot(true);
+	_discoveryProgressHideTimer.setInterval(1000);
+	connect(&_discoveryProgressHideTimer, &QTimer::timeout, ui->_discoveryProgress, &QProgressBar::hide);
+
+	// Only the folder the cursor has rested on is prefetched, not every one it passes while scrolling
+	_prefetchTimer.setSingleShot(true);
+	_prefetchTimer.setInterval(300);
+	connect(&_prefetchTimer, &QTimer::timeout, [this]() {
+		_controller.prefetchFolder(_panelPosition, _prefetchCandidateHash);
+	});
+
 	ui->_pathNavigator->setLineEdit(new CLineEdit);
 	ui->_pathNavigator->setHistoryMode(true);
 	connect(ui->_pathNavigator, static_cast<void (CHistoryComboBox::*) (const QString&)>(&CHistoryComboBox::activated), this, &CPanelWidget::pathFromHistoryActivated);
@@ -131,14 +145,19 @@ void CPanelWidget::setPanelPosition(Panel p)
 	connect(_model, &CFileListModel::itemEdited, this, &CPanelWidget::itemNameEdited);
 
 	_sortModel = new(std::nothrow) CFileListSortFilterProxyModel(this);
-	_sortModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
-	_sortModel->setFilterRole(FullNameRole);
 	_sortModel->setPanelPosition(p);
 	_sortModel->setSourceModel(_model);
 
 	ui->_list->setModel(_sortModel);
 	connect(_sortModel, &QSortFilterProxyModel::modelAboutToBeReset, ui->_list, &CFileListView::modelAboutToBeReset);
 	connect(_sortModel, &CFileListSortFilterProxyModel::sorted, ui->_list, [=](){
+		if (_cursorPlacementPending)
+		{
+			disconnect(_selectionModel, &QItemSelectionModel::currentChanged, this, &CPanelWidget::currentItemChanged);
+			placeCursorInNewListing();
+			connect(_selectionModel, &QItemSelectionModel::currentChanged, this, &CPanelWidget::currentItemChanged);
+		}
+
 		ui->_list->scrollTo(ui->_list->currentIndex());
 	});
 
@@ -154,9 +173,11 @@ void CPanelWidget::setPanelPosition(Panel p)
 	_controller.setDisksChangedListener(this);
 }
 
-// Returns the list of items added to the view
-void CPanelWidget::fillFromList(const std::map<qulonglong, CFileSystemObject>& items, FileListRefreshCause operation)
+// Displays a new listing; the model shares the snapshot rather than copying the items
+void CPanelWidget::fillFromList(const std::shared_ptr<const CFileListSnapshot>& snapshot, FileListRefreshCause operation)
 {
+	const auto& items = snapshot->items();
+
 	time_t start = clock();
 	const auto globalStart = start;
 
@@ -167,127 +188,127 @@ void CPanelWidget::fillFromList(const std::map<qulonglong, CFileSystemObject>& i
 
 	//ui->_list->setUpdatesEnabled(false);
 	ui->_list->saveHeaderState();
-	_sortModel->setSourceModel(nullptr);
-	_model->clear();
-
-	_model->setColumnCount(NumberOfColumns);
-	_model->setHorizontalHeaderLabels(QStringList() << tr("Name") << tr("Ext") << tr("Size") << tr("Date"));
-
-	int itemRow = 0;
-	std::vector<std::tuple<int, FileListViewColumns, QStandardItem*>> qTreeViewItems;
-	qTreeViewItems.reserve(items.size() * NumberOfColumns);
-
-	for (const auto& item: items)
-	{
-		const CFileSystemObject& object = item.second;
-		auto props = object.properties();
-
-		QStandardItem * fileNameItem = new QStandardItem();
-		fileNameItem->setEditable(false);
-		if (props.type == Directory)
-			fileNameItem->setData(QString("[" % (object.isCdUp() ? QString("..") : props.fullName) % "]"), Qt::DisplayRole);
-		else if (props.completeBaseName.isEmpty() && props.type == File) // File without a name, displaying extension in the name field and adding point to extension
-			fileNameItem->setData(QString('.') + props.extension, Qt::DisplayRole);
-		else
-			fileNameItem->setData(props.completeBaseName, Qt::DisplayRole);
-		fileNameItem->setIcon(object.icon());
-		fileNameItem->setData(props.hash, Qt::UserRole); // Unique identifier for this object;
-		qTreeViewItems.emplace_back(itemRow, NameColumn, fileNameItem);
-
-		QStandardItem * fileExtItem = new QStandardItem();
-		fileExtItem->setEditable(false);
-		if (!props.completeBaseName.isEmpty() && !props.extension.isEmpty())
-			fileExtItem->setData(props.extension, Qt::DisplayRole);
-		fileExtItem->setData(props.hash, Qt::UserRole); // Unique identifier for this object;
-		qTreeViewItems.emplace_back(itemRow, ExtColumn, fileExtItem);
-
-		QStandardItem * sizeItem = new QStandardItem();
-		sizeItem->setEditable(false);
-		if (props.type != Directory || props.size > 0)
-			sizeItem->setData(fileSizeToString(props.size), Qt::DisplayRole);
-		sizeItem->setData(props.hash, Qt::UserRole); // Unique identifier for this object;
-		qTreeViewItems.emplace_back(itemRow, SizeColumn, sizeItem);
-
-		QStandardItem * dateItem = new QStandardItem();
-		dateItem->setEditable(false);
-		QDateTime modificationDate;
-		modificationDate.setTime_t((uint)props.modificationDate);
-		modificationDate = modificationDate.toLocalTime();
-		dateItem->setData(modificationDate.toString("dd.MM.yyyy hh:mm"), Qt::DisplayRole);
-		dateItem->setData(props.hash, Qt::UserRole); // Unique identifier for this object;
-		qTreeViewItems.emplace_back(itemRow, DateColumn, dateItem);
-
-		++itemRow;
-	}
 
-	qDebug () << __FUNCTION__ << "Creating" << items.size() << "items took" << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
-
-	start = clock();
-	for (const auto& qTreeViewItem: qTreeViewItems)
-		_model->setItem(std::get<0>(qTreeViewItem), std::get<1>(qTreeViewItem), std::get<2>(qTreeViewItem));
+	// The model only references the listing; display strings and icons are produced lazily for the rows being painted
+	_model->setItems(snapshot);
 	qDebug () << __FUNCTION__ << "Setting" << items.size() << "items to the model took" << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
 
-	start = clock();
-	_sortModel->setSourceModel(_model);
-	qDebug () << __FUNCTION__ << "Setting the source model to sort model took" << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
-
 	ui->_list->restoreHeaderState();
 
-	ui->_list->moveCursorToItem(_sortModel->index(0, 0));
-
 	// Setting the cursor position as appropriate
+	_cursorTargetHash = 0;
+	_cursorFallbackRow = -1;
 	if (operation == refreshCauseCdUp)
 	{
 		// Setting the folder we've just stepped out of as current
-		qulonglong targetFolderHash = 0;
 		for (auto& item: items)
 		{
 			if (item.second.fullAbsolutePath() == previousFolder)
 			{
-				targetFolderHash = item.first;
+				_cursorTargetHash = item.first;
 				break;
 			}
 		}
-
-		if (targetFolderHash != 0)
-			ui->_list->moveCursorToItem(indexByHash(targetFolderHash));
 	}
-	else if (operation != refreshCauseForwardNavigation || CSettings().value(KEY_INTERFACE_RESPECT_LAST_CURSOR_POS).toBool())
+	else if (operation != refreshCauseForwardNavigation || CSettingsStore::get().valueAs<bool>(KEY_INTERFACE_RESPECT_LAST_CURSOR_POS, false))
 	{
-		const qulonglong itemHashToSetCursorTo = _controller.currentItemInFolder(_panelPosition, _controller.panel(_panelPosition).currentDirPathNative());
-		const QModelIndex itemIndexToSetCursorTo = indexByHash(itemHashToSetCursorTo);
-		if (itemIndexToSetCursorTo.isValid())
-			ui->_list->moveCursorToItem(itemIndexToSetCursorTo);
-		else if (previousCurrentIndex.isValid())
-			ui->_list->moveCursorToItem(_sortModel->index(previousCurrentIndex.row(), 0));
+		_cursorTargetHash = _controller.currentItemInFolder(_panelPosition, _controller.panel(_panelPosition).currentDirPathNative());
+		_cursorFallbackRow = previousCurrentIndex.isValid() ? previousCurrentIndex.row() : -1;
 	}
 
+	// A large listing is only shown once it's sorted, and so is the cursor
+	_cursorPlacementPending = true;
+	if (!_sortModel->rowsHiddenUntilSorted())
+		placeCursorInNewListing();
+
 	connect(_selectionModel, &QItemSelectionModel::currentChanged, this, &CPanelWidget::currentItemChanged);
+	// The model reset has cleared the selection without notifying about the deselected rows
+	rebuildSelectionStatistics();
 	selectionChanged(QItemSelection(), QItemSelection());
 
 	qDebug () << __FUNCTION__ << items.size() << "items," << (clock() - globalStart) * 1000 / CLOCKS_PER_SEC << "ms";
 }
 
+// Applies a new listing of the folder being displayed as row removals, updates and insertions, so that the scroll position, cursor and selection stay where they are
+void CPanelWidget::updateFromList(const std::shared_ptr<const CFileListSnapshot>& snapshot)
+{
+	time_t start = clock();
+
+	// The cursor may move as the rows are removed, this shouldn't be remembered as the user's choice
+	const qulonglong previousCurrentItemHash = currentItemHash();
+	disconnect(_selectionModel, &QItemSelectionModel::currentChanged, this, &CPanelWidget::currentItemChanged);
+
+	_model->updateItems(snapshot);
+
+	// Moving the cursor if it has been requested for this folder (e. g. after renaming the current item)
+	const qulonglong itemHashToSetCursorTo = _controller.currentItemInFolder(_panelPosition, _controller.panel(_panelPosition).currentDirPathNative());
+	const QModelIndex itemIndexToSetCursorTo = indexByHash(itemHashToSetCursorTo);
+	if (itemIndexToSetCursorTo.isValid() && itemIndexToSetCursorTo.row() != _selectionModel->currentIndex().row())
+		ui->_list->moveCursorToItem(itemIndexToSetCursorTo);
+	else if (!_selectionModel->currentIndex().isValid())
+		ui->_list->moveCursorToItem(_sortModel->index(0, 0));
+
+	connect(_selectionModel, &QItemSelectionModel::currentChanged, this, &CPanelWidget::currentItemChanged);
+	if (currentItemHash() != previousCurrentItemHash)
+		currentItemChanged(_selectionModel->currentIndex(), QModelIndex());
+	// Selected items may have changed in place, their old sizes are no longer valid
+	rebuildSelectionStatistics();
+	selectionChanged(QItemSelection(), QItemSelection());
+
+	qDebug () << __FUNCTION__ << snapshot->items().size() << "items," << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
+}
+
+// Moves the cursor to the item chosen by fillFromList(), once the new listing is displayed
+void CPanelWidget::placeCursorInNewListing()
+{
+	_cursorPlacementPending = false;
+	ui->_list->moveCursorToItem(_sortModel->index(0, 0));
+
+	const QModelIndex targetIndex = indexByHash(_cursorTargetHash);
+	if (targetIndex.isValid())
+		ui->_list->moveCursorToItem(targetIndex);
+	else if (_cursorFallbackRow >= 0)
+		ui->_list->moveCursorToItem(_sortModel->index(_cursorFallbackRow, 0));
+}
+
 void CPanelWidget::fillFromPanel(const CPanel &panel, FileListRefreshCause operation)
 {
-	const auto itemList = panel.list();
+	// The discovery is over once its results are here
+	_discoveryProgressHideTimer.stop();
+	ui->_discoveryProgress->hide();
+
+	// The snapshot is shared with the panel and the model, the items are never copied
+	const auto snapshot = panel.snapshot();
+	const QString currentDirectory = toPosixSeparators(panel.currentDirPathNative());
+	if (currentDirectory == _directoryCurrentlyBeingDisplayed)
+	{
+		// Same folder - only the rows that have actually changed are touched
+		updateFromList(snapshot);
+		fillHistory();
+		updateCurrentDiskButton();
+		return;
+	}
+
 	const auto previousSelection = selectedItemsHashes(true);
-	std::set<qulonglong> selectedItemsHashes; // For fast search
-	for (auto hash = previousSelection.begin(); hash != previousSelection.end(); ++hash)
-		selectedItemsHashes.insert(*hash);
 
-	fillFromList(itemList, operation);
-	_directoryCurrentlyBeingDisplayed = toPosixSeparators(panel.currentDirPathNative());
+	fillFromList(snapshot, operation);
+	_directoryCurrentlyBeingDisplayed = currentDirectory;
+	CStartupTrace::milestone(_panelPosition == LeftPanel ? "left panel displayed" : "right panel displayed");
 
 	// Restoring previous selection
-	if (!selectedItemsHashes.empty())
-		for (int row = 0; row < _sortModel->rowCount(); ++row)
+	if (!previousSelection.empty())
+	{
+		QItemSelection selection;
+		for (const qulonglong hash: previousSelection)
 		{
-			const qulonglong hash = hashByItemRow(row);
-			if (selectedItemsHashes.count(hash) != 0)
-				_selectionModel->select(_sortModel->index(row, 0), QItemSelectionModel::Rows | QItemSelectionModel::Select);
+			const QModelIndex index = indexByHash(hash);
+			if (index.isValid())
+				selection.select(index, index);
 		}
 
+		_selectionModel->select(selection, QItemSelectionModel::Rows | QItemSelectionModel::Select);
+	}
+
 	fillHistory();
 	updateCurrentDiskButton();
 }
@@ -300,12 +321,13 @@ void CPanelWidget::showContextMenuForItems(QPoint pos)
 		paths.push_back(_controller.panel(_panelPosition).currentDirPathNative().toStdWString());
 	else
 	{
+		const auto snapshot = _controller.panel(_panelPosition).snapshot();
 		for (size_t i = 0; i < selection.size(); ++i)
 		{
-			if (!_controller.itemByHash(_panelPosition, selection[i]).isCdUp() || selection.size() == 1)
+			const CFileSystemObject* item = snapshot->item(selection[i]);
+			if (item && (!item->isCdUp() || selection.size() == 1))
 			{
-				QString selectedItemPath = _controller.itemPath(_panelPosition, selection[i]);
-				paths.push_back(selectedItemPath.toStdWString());
+				paths.push_back(item->fullAbsolutePath().toStdWString());
 			}
 			else if (!selection.empty())
 			{
@@ -367,33 +389,42 @@ void CPanelWidget::driveButtonClicked()
 	ui->_list->setFocus();
 }
 
-void CPanelWidget::selectionChanged(const QItemSelection& selected, const QItemSelection& /*deselected*/)
+void CPanelWidget::selectionChanged(const QItemSelection& selected, const QItemSelection& deselected)
 {
-	// This doesn't let the user select the [..] item
+	// Only the rows that have changed are accounted for, so the cost doesn't depend on the total number of selected items
+	for (const auto& indexRange: deselected)
+		removeFromSelectionStatistics(indexRange);
 
-	const QString cdUpPath = CFileSystemObject(QFileInfo(currentDir())).parentDirPath();
-	for (auto indexRange: selected)
+	for (const auto& indexRange: selected)
+		addToSelectionStatistics(indexRange);
+
+	// This doesn't let the user select the [..] item
+	for (const auto& indexRange: selected)
 	{
-		auto indexList = indexRange.indexes();
-		for (const auto& index: indexList)
+		bool cdUpDeselected = false;
+		for (int row = indexRange.top(); row <= indexRange.bottom(); ++row)
 		{
-			const auto hash = hashByItemIndex(index);
-			if (_controller.itemByHash(_panelPosition, hash).fullAbsolutePath() == cdUpPath)
+			const QModelIndex index = _sortModel->index(row, 0);
+			if (_model->itemAtRow(_sortModel->mapToSource(index).row()).isCdUp())
 			{
-				auto cdUpIndex = indexByHash(hash);
-				assert_r(cdUpIndex.isValid());
-				_selectionModel->select(cdUpIndex, QItemSelectionModel::Deselect | QItemSelectionModel::Rows);
+				_selectionModel->select(index, QItemSelectionModel::Deselect | QItemSelectionModel::Rows);
+				cdUpDeselected = true;
 				break;
 			}
 		}
+
+		if (cdUpDeselected)
+			break;
 	}
 
-	const auto selection = selectedItemsHashes();
 	// Updating the selection summary label
-	updateInfoLabel(selection);
+	updateInfoLabel();
 
-	// Notify the controller of the new selection
-	CPluginEngine::get().selectionChanged(_panelPosition, selection);
+	// Notify the controller of the new selection. Listing the selected items takes time proportional to their number, so it's only done if a plugin asks for them.
+	const QPointer<const CPanelWidget> panelWidget(this);
+	CPluginEngine::get().selectionChanged(_panelPosition, [panelWidget]() {
+		return panelWidget ? panelWidget->selectedItemsHashes() : std::vector<qulonglong>();
+	});
 }
 
 void CPanelWidget::currentItemChanged(const QModelIndex& current, const QModelIndex& /*previous*/)
@@ -401,6 +432,12 @@ void CPanelWidget::currentItemChanged(const QModelIndex& current, const QModelIn
 	const qulonglong hash = current.isValid() ? hashByItemIndex(current) : 0;
 	_controller.setCursorPositionForCurrentFolder(hash);
 
+	_prefetchCandidateHash = hash;
+	if (hash != 0)
+		_prefetchTimer.start();
+	else
+		_prefetchTimer.stop();
+
 	emit currentItemChangedSignal(_panelPosition, hash);
 }
 
@@ -525,7 +562,7 @@ void CPanelWidget::showFilterEditor()
 
 void CPanelWidget::filterTextChanged(QString filterText)
 {
-	_sortModel->setFilterWildcard(filterText);
+	_sortModel->setQuickFilter(filterText);
 }
 
 void CPanelWidget::copySelectionToClipboard() const
@@ -606,9 +643,10 @@ void CPanelWidget::pasteSelectionFromClipboard()
 #else
 	void* hwnd = (void*)winId();
 	const auto currentDirWString = currentDir().toStdWString();
-	_controller.execOnWorkerThread([=]() {
+	// The shell may show its own conflict resolution and progress UI, which can take arbitrarily long; this would pin a scheduler worker
+	std::thread([=]() {
 		CShell::pasteFromClipboard(currentDirWString, hwnd);
-	});
+	}).detach();
 #endif
 }
 
@@ -631,43 +669,90 @@ void CPanelWidget::fillHistory()
 	ui->_pathNavigator->setCurrentIndex(static_cast<int>(history.size() - 1 - history.currentIndex()));
 }
 
-void CPanelWidget::updateInfoLabel(const std::vector<qulonglong>& selection)
+void CPanelWidget::updateInfoLabel()
 {
-	ui->_infoLabel->clear();
+	// The totals are maintained by the panel per listing, the selection totals - incrementally as the selection changes
+	const FilesystemObjectsStatistics total = _controller.panel(_panelPosition).listingStatistics();
+	FilesystemObjectsStatistics selection = _selectionStatistics;
+	if (_selectedItemsStatistics.empty())
+	{
+		// No selection - the current item is the subject of operations
+		const QModelIndex currentIndex = _selectionModel->currentIndex();
+		if (currentIndex.isValid())
+		{
+			const CFileSystemObject& object = _model->itemAtRow(_sortModel->mapToSource(currentIndex).row());
+			if (!object.isCdUp())
+				selection = FilesystemObjectsStatistics(object.isFile() ? 1 : 0, object.isDir() ? 1 : 0, object.size());
+		}
+	}
 
-	uint64_t numFilesSelected = 0, numFoldersSelected = 0, totalSize = 0, sizeSelected = 0, totalNumFolders = 0, totalNumFiles = 0;
-	const auto currentTotalList = _controller.panel(_panelPosition).list();
-	for (auto it = currentTotalList.begin(); it != currentTotalList.end(); ++it)
+	ui->_infoLabel->setText(tr("%1/%2 files, %3/%4 folders selected (%5 / %6)").arg(selection.files).arg(total.files).
+		arg(selection.folders).arg(total.folders).
+		arg(fileSizeToString(selection.occupiedSpace)).arg(fileSizeToString(total.occupiedSpace)));
+}
+
+// Adds the items in the range to / removes them from the running selection statistics
+void CPanelWidget::addToSelectionStatistics(const QItemSelectionRange& range)
+{
+	if (range.model() != _sortModel)
+		return;
+
+	for (int row = range.top(); row <= range.bottom(); ++row)
 	{
-		const CFileSystemObject& object = it->second;
-		if (object.isFile())
-			++totalNumFiles;
-		else if (object.isDir())
-			++totalNumFolders;
-		totalSize += object.size();
+		const QModelIndex sourceIndex = _sortModel->mapToSource(_sortModel->index(row, 0, range.parent()));
+		if (!sourceIndex.isValid())
+			continue;
+
+		const CFileSystemObject& object = _model->itemAtRow(sourceIndex.row());
+		if (object.isCdUp())
+			continue;
+
+		const FilesystemObjectsStatistics contribution(object.isFile() ? 1 : 0, object.isDir() ? 1 : 0, object.size());
+		if (!_selectedItemsStatistics.emplace(object.hash(), contribution).second)
+			continue; // Already accounted for
+
+		_selectionStatistics.files += contribution.files;
+		_selectionStatistics.folders += contribution.folders;
+		_selectionStatistics.occupiedSpace += contribution.occupiedSpace;
 	}
+}
+
+void CPanelWidget::removeFromSelectionStatistics(const QItemSelectionRange& range)
+{
+	if (range.model() != _sortModel)
+		return;
 
-	for (auto it = selection.begin(); it != selection.end(); ++it)
+	for (int row = range.top(); row <= range.bottom(); ++row)
 	{
-		const CFileSystemObject object = _controller.itemByHash(_panelPosition, *it);
-		if (object.isFile())
-			++numFilesSelected;
-		else if (object.isDir())
-			++numFoldersSelected;
+		const QModelIndex sourceIndex = _sortModel->mapToSource(_sortModel->index(row, 0, range.parent()));
+		if (!sourceIndex.isValid())
+			continue;
+
+		const auto contribution = _selectedItemsStatistics.find(_model->itemAtRow(sourceIndex.row()).hash());
+		if (contribution == _selectedItemsStatistics.end())
+			continue;
 
-		sizeSelected += object.size();
+		_selectionStatistics.files -= contribution->second.files;
+		_selectionStatistics.folders -= contribution->second.folders;
+		_selectionStatistics.occupiedSpace -= contribution->second.occupiedSpace;
+		_selectedItemsStatistics.erase(contribution);
 	}
+}
 
-	ui->_infoLabel->setText(tr("%1/%2 files, %3/%4 folders selected (%5 / %6)").arg(numFilesSelected).arg(totalNumFiles).
-		arg(numFoldersSelected).arg(totalNumFolders).
-		arg(fileSizeToString(sizeSelected)).arg(fileSizeToString(totalSize)));
+// Recounts the selection statistics from the selection model, for when the model has changed without per-row selection notifications
+void CPanelWidget::rebuildSelectionStatistics()
+{
+	_selectedItemsStatistics.clear();
+	_selectionStatistics = FilesystemObjectsStatistics();
+	for (const auto& indexRange: _selectionModel->selection())
+		addToSelectionStatistics(indexRange);
 }
 
 bool CPanelWidget::fileListReturnPressOrDoubleClickPerformed(const QModelIndex& item)
 {
 	assert_r(item.isValid());
 	QModelIndex source = _sortModel->mapToSource(item);
-	const qulonglong hash = _model->item(source.row(), source.column())->data(Qt::UserRole).toULongLong();
+	const qulonglong hash = _model->itemHash(source);
 	emit itemActivated(hash, this);
 	return true; // Consuming the event
 }
@@ -699,12 +784,10 @@ void CPanelWidget::disksChanged(const std::vector<CDiskEnumerator::DiskInfo>& dr
 	// Creating and adding new buttons
 	for (size_t i = 0; i < drives.size(); ++i)
 	{
-		const auto& driveInfo = drives[i].storageInfo;
-		if (!driveInfo.isValid())
-			continue;
+		const auto& driveInfo = drives[i];
 
 #ifdef _WIN32
-		const QString name = driveInfo.rootPath().remove(":/");
+		const QString name = QString(driveInfo.rootPath).remove(":/");
 #else
 		QString name = driveInfo.displayName();
 		if (name.startsWith("/") && name.indexOf('/', 1) != -1)
@@ -717,7 +800,7 @@ void CPanelWidget::disksChanged(const std::vector<CDiskEnumerator::DiskInfo>& dr
 		assert_r(layout);
 		QPushButton * diskButton = new QPushButton;
 		diskButton->setCheckable(true);
-		diskButton->setIcon(drives[i].fileSystemObject.icon());
+		diskButton->setIcon(driveInfo.fileSystemObject.icon());
 		diskButton->setText(name);
 		diskButton->setFixedWidth(QFontMetrics(diskButton->font()).width(diskButton->text()) + 5 + diskButton->iconSize().width() + 20);
 		diskButton->setProperty("id", (qulonglong)i);
@@ -735,29 +818,19 @@ qulonglong CPanelWidget::hashByItemIndex(const QModelIndex &index) const
 {
 	if (!index.isValid())
 		return 0;
-	QStandardItem * item = _model->item(_sortModel->mapToSource(index).row(), 0);
-	assert_r(item);
-	bool ok = false;
-	const qulonglong hash = item->data(Qt::UserRole).toULongLong(&ok);
-	assert_r(ok);
+	const qulonglong hash = _model->itemHash(_sortModel->mapToSource(index));
+	assert_r(hash != 0);
 	return hash;
 }
 
-qulonglong CPanelWidget::hashByItemRow(const int row) const
-{
-	return hashByItemIndex(_sortModel->index(row, 0));
-}
-
 QModelIndex CPanelWidget::indexByHash(const qulonglong hash) const
 {
 	if (hash == 0)
 		return QModelIndex();
 
-	for(int row = 0; row < _sortModel->rowCount(); ++row)
-		if (hashByItemRow(row) == hash)
-			return _sortModel->index(row, 0);
-
-	return QModelIndex();
+	// Both lookups are constant time: the model indexes its rows by hash, and the proxy keeps the source to proxy row mapping between layout changes
+	const int sourceRow = _model->rowByHash(hash);
+	return sourceRow >= 0 ? _sortModel->mapFromSource(_model->index(sourceRow, 0)) : QModelIndex();
 }
 
 bool CPanelWidget::eventFilter(QObject * object, QEvent * e)
@@ -794,12 +867,25 @@ void CPanelWidget::panelContentsChanged(Panel p , FileListRefreshCause operation
 		fillFromPanel(_controller.panel(_panelPosition), operation);
 }
 
-void CPanelWidget::itemDiscoveryInProgress(Panel p, qulonglong itemHash, size_t progress, const QString& currentDir)
+void CPanelWidget::itemDiscoveryInProgress(Panel p, qulonglong /*itemHash*/, size_t progress, const QString& currentDir)
 {
 	if (p != _panelPosition)
 		return;
 
-	qDebug() << QString("Discovering %1: %2%, scanning %3").arg(itemHash).arg(progress).arg(currentDir);
+	// progress > 100 means indefinite
+	if (progress <= 100)
+	{
+		ui->_discoveryProgress->setRange(0, 100);
+		ui->_discoveryProgress->setValue((int)progress);
+	}
+	else
+		ui->_discoveryProgress->setRange(0, 0); // Busy indicator
+
+	ui->_discoveryProgress->setToolTip(toNativeSeparators(currentDir));
+	ui->_discoveryProgress->show();
+
+	// Not every discovery ends with a contents change notification (e. g. calculating statistics for a dialog), so the indicator also goes away once the updates stop coming
+	_discoveryProgressHideTimer.start();
 }
 
 CFileListView *CPanelWidget::fileListView() const
@@ -824,11 +910,12 @@ std::vector<qulonglong> CPanelWidget::selectedItemsHashes(bool onlyHighlightedIt
 
 	if (!selection.empty())
 	{
+		result.reserve(selection.size());
 		for (auto it = selection.begin(); it != selection.end(); ++it)
 		{
-			const qulonglong hash = hashByItemIndex(*it);
-			if (!_controller.itemByHash(_panelPosition, hash).isCdUp())
-				result.push_back(hash);
+			const CFileSystemObject& item = _model->itemAtRow(_sortModel->mapToSource(*it).row());
+			if (!item.isCdUp())
+				result.push_back(item.hash());
 		}
 	}
 	else if (!onlyHighlightedItems)
@@ -836,9 +923,9 @@ std::vector<qulonglong> CPanelWidget::selectedItemsHashes(bool onlyHighlightedIt
 		auto currentIndex = _selectionModel->currentIndex();
 		if (currentIndex.isValid())
 		{
-			const auto hash = hashByItemIndex(currentIndex);
-			if (!_controller.itemByHash(_panelPosition, hash).isCdUp())
-				result.push_back(hash);
+			const CFileSystemObject& item = _model->itemAtRow(_sortModel->mapToSource(currentIndex).row());
+			if (!item.isCdUp())
+				result.push_back(item.hash());
 		}
 	}
 
@@ -876,11 +963,20 @@ void CPanelWidget::updateCurrentDiskButton()
 			button->setChecked(true);
 			const auto& diskInfo = _controller.diskEnumerator().drives()[id];
 			_currentDisk = diskInfo.fileSystemObject.fullAbsolutePath();
-			ui->_driveInfoLabel->setText(tr("%1 (%2): %3 available, <b>%4 free</b> of %5 total").arg(diskInfo.storageInfo.displayName()).
-				arg(QString::fromUtf8(diskInfo.storageInfo.fileSystemType())).
-				arg(fileSizeToString(diskInfo.storageInfo.bytesAvailable(), 'M', " ")).
-				arg(fileSizeToString(diskInfo.storageInfo.bytesFree(), 'M', " ")).
-				arg(fileSizeToString(diskInfo.storageInfo.bytesTotal(), 'M', " ")));
+			const QString fileSystemType = QString::fromUtf8(diskInfo.fileSystemType);
+			// The free space is left out rather than shown stale while the drive doesn't respond
+			if (diskInfo.freeSpaceIsKnown())
+				ui->_driveInfoLabel->setText(tr("%1 (%2): %3 available, <b>%4 free</b> of %5 total").arg(diskInfo.displayName()).
+					arg(fileSystemType).
+					arg(fileSizeToString(diskInfo.bytesAvailable, 'M', " ")).
+					arg(fileSizeToString(diskInfo.bytesFree, 'M', " ")).
+					arg(fileSizeToString(diskInfo.bytesTotal, 'M', " ")));
+			else if (!diskInfo.isResponding)
+				ui->_driveInfoLabel->setText(tr("%1 (%2): <b>not responding</b>").arg(diskInfo.displayName()).arg(fileSystemType));
+			else if (!diskInfo.isReady)
+				ui->_driveInfoLabel->setText(tr("%1 (%2): not ready").arg(diskInfo.displayName()).arg(fileSystemType));
+			else
+				ui->_driveInfoLabel->setText(tr("%1 (%2)").arg(diskInfo.displayName()).arg(fileSystemType));
 
 			return;
 		}
@@ -8,9 +8,12 @@
 DISABLE_COMPILER_WARNINGS
 #include <QItemSelection>
 #include <QShortcut>
+#include <QTimer>
 #include <QWidget>
 RESTORE_COMPILER_WARNINGS
 
+#include <unordered_map>
+
 namespace Ui {
 class CPanelWidget;
 }
@@ -45,8 +48,10 @@ public:
 	Panel panelPosition() const;
 	void setPanelPosition(Panel p);
 
-	// Returns the list of items added to the view
-	void fillFromList(const std::map<qulonglong, CFileSystemObject>& items, FileListRefreshCause operation);
+	// Displays a new listing; the model shares the snapshot rather than copying the items
+	void fillFromList(const std::shared_ptr<const CFileListSnapshot>& snapshot, FileListRefreshCause operation);
+	// Applies a new listing of the folder being displayed as row removals, updates and insertions, so that the scroll position, cursor and selection stay where they are
+	void updateFromList(const std::shared_ptr<const CFileListSnapshot>& snapshot);
 	void fillFromPanel(const CPanel& panel, FileListRefreshCause operation);
 
 	// CPanel observers
@@ -92,7 +97,13 @@ private slots:
 
 private:
 	void fillHistory();
-	void updateInfoLabel(const std::vector<qulonglong>& selection);
+	void updateInfoLabel();
+
+	// Adds the items in the range to / removes them from the running selection statistics
+	void addToSelectionStatistics(const QItemSelectionRange& range);
+	void removeFromSelectionStatistics(const QItemSelectionRange& range);
+	// Recounts the selection statistics from the selection model, for when the model has changed without per-row selection notifications
+	void rebuildSelectionStatistics();
 
 // Callbacks
 	bool fileListReturnPressOrDoubleClickPerformed(const QModelIndex& item) override;
@@ -100,10 +111,11 @@ private:
 
 // Internal methods
 	qulonglong hashByItemIndex(const QModelIndex& index) const;
-	qulonglong hashByItemRow(const int row) const;
 	QModelIndex indexByHash(const qulonglong hash) const;
 
 	void updateCurrentDiskButton();
+	// Moves the cursor to the item chosen by fillFromList(), once the new listing is displayed
+	void placeCursorInNewListing();
 
 private:
 	CFileListFilterDialog           _filterDialog;
@@ -117,12 +129,24 @@ private:
 	CFileListSortFilterProxyModel * _sortModel;
 	Panel                           _panelPosition;
 
+	std::unordered_map<qulonglong, FilesystemObjectsStatistics> _selectedItemsStatistics; // The contribution of each selected item to _selectionStatistics
+	FilesystemObjectsStatistics     _selectionStatistics;
+
 	QShortcut                       _calcDirSizeShortcut;
 	QShortcut                       _selectCurrentItemShortcut;
 	QShortcut                       _showFilterEditorShortcut;
 	QShortcut                       _copyShortcut;
 	QShortcut                       _cutShortcut;
 	QShortcut                       _pasteShortcut;
+
+	QTimer                          _discoveryProgressHideTimer;
+	QTimer                          _prefetchTimer; // Started when the cursor moves, the folder under the cursor is prefetched when it fires
+	qulonglong                      _prefetchCandidateHash = 0;
+
+	// Where to put the cursor in a new listing; a large one is only displayed once it's been sorted
+	bool                            _cursorPlacementPending = false;
+	qulonglong                      _cursorTargetHash = 0;
+	int                             _cursorFallbackRow = -1;
 };
 
 #endif // CPANELWIDGET_H
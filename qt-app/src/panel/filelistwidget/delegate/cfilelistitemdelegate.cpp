@@ -1,7 +1,6 @@
 #include "cfilelistitemdelegate.h"
 #include "assert/advanced_assert.h"
 #include "../model/cfilelistmodel.h"
-#include "ccontroller.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QApplication>
@@ -30,8 +29,7 @@ void CFileListItemDelegate::setEditorData(QWidget * editor, const QModelIndex &
 	assert_and_return_message_r(sortModel, "Something has changed in the model hierarchy", );
 	auto model = dynamic_cast<const CFileListModel*>(sortModel->sourceModel());
 	assert_and_return_message_r(model, "Something has changed in the model hierarchy", );
-	auto hash = model->itemHash(sortModel->mapToSource(index));
-	const auto item = CController::get().itemByHash(model->panelPosition(), hash);
+	const CFileSystemObject& item = model->itemAtRow(sortModel->mapToSource(index).row());
 
 	if (item.isValid() && item.isFile())
 	{
@@ -0,0 +1,108 @@
+#include "cfilelistfilterengine.h"
+
+// How often the cancellation flag is checked
+static const size_t rowsBetweenCancellationChecks = 4096;
+
+CFileListFilterEngine::Names::Names() : offsets(1, 0)
+{
+}
+
+void CFileListFilterEngine::Names::append(const QString& name)
+{
+	const QString foldedName = name.toCaseFolded();
+	characters.insert(characters.end(), foldedName.constData(), foldedName.constData() + foldedName.size());
+	offsets.push_back((uint32_t)characters.size());
+}
+
+size_t CFileListFilterEngine::Names::size() const
+{
+	return offsets.size() - 1;
+}
+
+CFileListFilterEngine::CFileListFilterEngine(const QString& pattern) : _pattern(pattern)
+{
+	for (const QString& segment: pattern.toCaseFolded().split('*', QString::SkipEmptyParts))
+		_segments.emplace_back(segment);
+}
+
+const QString& CFileListFilterEngine::pattern() const
+{
+	return _pattern;
+}
+
+// An empty pattern matches everything
+bool CFileListFilterEngine::isEmpty() const
+{
+	return _segments.empty();
+}
+
+// Returns true if every name that matches this pattern also matches the other one, which is the case when this pattern extends the other
+bool CFileListFilterEngine::refines(const CFileListFilterEngine& other) const
+{
+	// The match is not anchored to either end of the name, so a longer pattern with the same beginning can only match fewer names
+	return _pattern.startsWith(other._pattern);
+}
+
+bool CFileListFilterEngine::matches(const QString& name) const
+{
+	if (isEmpty())
+		return true;
+
+	const QString foldedName = name.toCaseFolded();
+	return matches(foldedName.constData(), foldedName.size());
+}
+
+bool CFileListFilterEngine::matches(const QChar * foldedName, int length) const
+{
+	// Finding the earliest occurrence of each segment after the previous one is enough to tell whether the whole pattern matches
+	int position = 0;
+	for (const Segment& segment: _segments)
+	{
+		const int segmentPosition = indexOf(segment, foldedName, length, position);
+		if (segmentPosition < 0)
+			return false;
+
+		position = segmentPosition + segment.text.size();
+	}
+
+	return true;
+}
+
+// Returns the rows that match in ascending order, checking either all the rows or only the candidate ones. Returns an empty vector if cancelled.
+std::vector<int> CFileListFilterEngine::matchingRows(const Names& names, const std::vector<int>* candidateRows, const std::atomic<bool>& cancelled) const
+{
+	std::vector<int> result;
+	const size_t numRowsToCheck = candidateRows ? candidateRows->size() : names.size();
+	for (size_t i = 0; i < numRowsToCheck; ++i)
+	{
+		if (i % rowsBetweenCancellationChecks == 0 && cancelled)
+			return std::vector<int>();
+
+		const size_t row = candidateRows ? (size_t)(*candidateRows)[i] : i;
+		const uint32_t begin = names.offsets[row];
+		if (matches(names.characters.data() + begin, (int)(names.offsets[row + 1] - begin)))
+			result.push_back((int)row);
+	}
+
+	return result;
+}
+
+int CFileListFilterEngine::indexOf(const Segment& segment, const QChar * str, int length, int from)
+{
+	if (!segment.hasJokers)
+		return segment.matcher.indexIn(str, length, from);
+
+	const int segmentLength = segment.text.size();
+	const QChar * segmentText = segment.text.constData();
+	for (int start = from; start + segmentLength <= length; ++start)
+	{
+		int i = 0;
+		while (i < segmentLength && (segmentText[i] == '?' || segmentText[i] == str[start + i]))
+			++i;
+
+		if (i == segmentLength)
+			return start;
+	}
+
+	return -1;
+}
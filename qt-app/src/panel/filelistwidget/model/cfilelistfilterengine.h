@@ -0,0 +1,57 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QString>
+#include <QStringMatcher>
+RESTORE_COMPILER_WARNINGS
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+// Matches file names against the quick filter pattern: case-insensitively, anywhere within the name, '*' standing for any number of characters and '?' for any single character
+class CFileListFilterEngine
+{
+public:
+	// The case-folded names of all the rows, stored back to back in a single buffer
+	struct Names {
+		Names();
+		void append(const QString& name);
+		size_t size() const;
+
+		std::vector<QChar>    characters;
+		std::vector<uint32_t> offsets; // The name of row N occupies [offsets[N], offsets[N + 1])
+	};
+
+	explicit CFileListFilterEngine(const QString& pattern = QString());
+
+	const QString& pattern() const;
+	// An empty pattern matches everything
+	bool isEmpty() const;
+	// Returns true if every name that matches this pattern also matches the other one, which is the case when this pattern extends the other
+	bool refines(const CFileListFilterEngine& other) const;
+
+	bool matches(const QString& name) const;
+	bool matches(const QChar * foldedName, int length) const;
+
+	// Returns the rows that match in ascending order, checking either all the rows or only the candidate ones. Returns an empty vector if cancelled.
+	std::vector<int> matchingRows(const Names& names, const std::vector<int>* candidateRows, const std::atomic<bool>& cancelled) const;
+
+private:
+	// The parts of the pattern between the asterisks
+	struct Segment {
+		explicit Segment(const QString& segmentText) : text(segmentText), matcher(segmentText, Qt::CaseSensitive), hasJokers(segmentText.contains('?')) {}
+
+		QString        text;
+		QStringMatcher matcher;   // Boyer-Moore search, used if there are no '?' in the segment
+		bool           hasJokers;
+	};
+
+	static int indexOf(const Segment& segment, const QChar * str, int length, int from);
+
+private:
+	QString              _pattern;
+	std::vector<Segment> _segments;
+};
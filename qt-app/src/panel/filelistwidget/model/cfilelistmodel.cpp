@@ -5,17 +5,23 @@
 #include "../../columns.h"
 
 DISABLE_COMPILER_WARNINGS
+#include <QFileIconProvider>
 #include <QMimeData>
+#include <QPointer>
 #include <QUrl>
 RESTORE_COMPILER_WARNINGS
 
+#include <algorithm>
+#include <memory>
 #include <set>
 
 CFileListModel::CFileListModel(QTreeView * treeView, QObject *parent) :
-	QStandardItemModel(0, NumberOfColumns, parent),
+	QAbstractItemModel(parent),
 	_controller(CController::get()),
 	_tree(treeView),
-	_panel(UnknownPanel)
+	_panel(UnknownPanel),
+	_folderPlaceholderIcon(QFileIconProvider().icon(QFileIconProvider::Folder)),
+	_filePlaceholderIcon(QFileIconProvider().icon(QFileIconProvider::File))
 {
 }
 
@@ -36,26 +42,166 @@ QTreeView *CFileListModel::treeView() const
 	return _tree;
 }
 
-QVariant CFileListModel::data(const QModelIndex & index, int role /*= Qt::DisplayRole*/) const
+// Replaces the contents of the model with a new listing snapshot; nothing is copied, display data is only produced on request in data()
+void CFileListModel::setItems(const std::shared_ptr<const CFileListSnapshot>& snapshot)
+{
+	beginResetModel();
+	_snapshot = snapshot;
+	_items.clear();
+	_items.reserve(snapshot->items().size());
+	for (const auto& item: snapshot->items())
+		_items.push_back(&item.second);
+	rebuildRowIndex();
+
+	++_iconGeneration;
+	_icons.clear();
+	_iconRequests.clear();
+	_iconsRequested.clear();
+	_nextBackgroundIconRow = 0;
+	endResetModel();
+}
+
+// Brings the model in line with a new listing snapshot of the same folder by removing, updating and appending individual rows
+void CFileListModel::updateItems(const std::shared_ptr<const CFileListSnapshot>& snapshot)
 {
-	if (role == Qt::ToolTipRole)
+	const auto& newItems = snapshot->items();
+	// The rows keep pointing into the previous snapshot until they're switched over below
+	const auto previousSnapshot = _snapshot;
+	_snapshot = snapshot;
+
+	// Removing the items that are gone in contiguous ranges, starting from the end so that the rows yet to be processed keep their numbers
+	for (int row = (int)_items.size() - 1; row >= 0; --row)
 	{
-		if (!index.isValid())
-			return QString();
+		if (newItems.count(_items[(size_t)row]->hash()) != 0)
+			continue;
 
-		const CFileSystemObject item = _controller.itemByHash(_panel, itemHash(index));
-		return QString(item.fullName() % "\n\n" % QString::fromStdWString(CShell::toolTip(item.fullAbsolutePath().toStdWString())));
+		int firstRow = row;
+		while (firstRow > 0 && newItems.count(_items[(size_t)firstRow - 1]->hash()) == 0)
+			--firstRow;
+
+		beginRemoveRows(QModelIndex(), firstRow, row);
+		_items.erase(_items.begin() + firstRow, _items.begin() + row + 1);
+		endRemoveRows();
+
+		row = firstRow;
 	}
-	else if (role == Qt::EditRole)
+
+	rebuildRowIndex();
+	_nextBackgroundIconRow = 0;
+
+	// Switching the items that are still there over to the new snapshot, notifying about those that have changed
+	for (size_t row = 0; row < _items.size(); ++row)
 	{
-		return _controller.itemByHash(_panel, itemHash(index)).fullName();
+		const CFileSystemObject& newItem = newItems.find(_items[row]->hash())->second;
+		const auto& oldProps = _items[row]->properties(), & newProps = newItem.properties();
+		const bool itemChanged = oldProps.type != newProps.type || oldProps.size != newProps.size || oldProps.modificationDate != newProps.modificationDate || oldProps.exists != newProps.exists;
+
+		_items[row] = &newItem;
+		if (itemChanged)
+		{
+			// The icon may depend on the type and the contents
+			_icons.erase(newProps.hash);
+			_iconsRequested.erase(newProps.hash);
+
+			emit dataChanged(index((int)row, 0), index((int)row, NumberOfColumns - 1));
+		}
 	}
-	else if (role == FullNameRole)
+
+	// Appending the new items; the proxy model puts them where they belong in the sorted order
+	if (newItems.size() == _items.size())
+		return;
+
+	beginInsertRows(QModelIndex(), (int)_items.size(), (int)newItems.size() - 1);
+	for (const auto& item: newItems)
 	{
-		return _controller.itemByHash(_panel, itemHash(index)).fullName();
+		if (_rowByHash.count(item.first) == 0)
+		{
+			_rowByHash[item.first] = (int)_items.size();
+			_items.push_back(&item.second);
+		}
+	}
+	endInsertRows();
+}
+
+// Returns the object at the specified source row
+const CFileSystemObject& CFileListModel::itemAtRow(int row) const
+{
+	assert_r(row >= 0 && (size_t)row < _items.size());
+	return *_items[(size_t)row];
+}
+
+// Returns the source row of the item with the specified hash, or -1 if there's no such item
+int CFileListModel::rowByHash(qulonglong hash) const
+{
+	const auto it = _rowByHash.find(hash);
+	return it != _rowByHash.end() ? it->second : -1;
+}
+
+QModelIndex CFileListModel::index(int row, int column, const QModelIndex & parent) const
+{
+	if (parent.isValid() || row < 0 || (size_t)row >= _items.size() || column < 0 || column >= NumberOfColumns)
+		return QModelIndex();
+
+	return createIndex(row, column);
+}
+
+QModelIndex CFileListModel::parent(const QModelIndex & /*child*/) const
+{
+	return QModelIndex(); // This is a flat list
+}
+
+int CFileListModel::rowCount(const QModelIndex & parent) const
+{
+	return parent.isValid() ? 0 : (int)_items.size();
+}
+
+int CFileListModel::columnCount(const QModelIndex & parent) const
+{
+	return parent.isValid() ? 0 : NumberOfColumns;
+}
+
+QVariant CFileListModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+		return QAbstractItemModel::headerData(section, orientation, role);
+
+	switch (section)
+	{
+	case NameColumn:
+		return tr("Name");
+	case ExtColumn:
+		return tr("Ext");
+	case SizeColumn:
+		return tr("Size");
+	case DateColumn:
+		return tr("Date");
+	default:
+		return QVariant();
+	}
+}
+
+QVariant CFileListModel::data(const QModelIndex & index, int role /*= Qt::DisplayRole*/) const
+{
+	if (!index.isValid() || (size_t)index.row() >= _items.size())
+		return role == Qt::ToolTipRole ? QVariant(QString()) : QVariant();
+
+	const CFileSystemObject& item = *_items[(size_t)index.row()];
+	switch (role)
+	{
+	case Qt::DisplayRole:
+		return displayData(item, index.column());
+	case Qt::DecorationRole:
+		return index.column() == NameColumn ? QVariant(iconForRow(index.row())) : QVariant();
+	case Qt::UserRole:
+		return item.hash(); // Unique identifier for this object
+	case Qt::ToolTipRole:
+		return QString(item.fullName() % "\n\n" % QString::fromStdWString(CShell::toolTip(item.fullAbsolutePath().toStdWString())));
+	case Qt::EditRole:
+	case FullNameRole:
+		return item.fullName();
+	default:
+		return QVariant();
 	}
-	else
-		return QStandardItemModel::data(index, role);
 }
 
 bool CFileListModel::setData(const QModelIndex & index, const QVariant & value, int role)
@@ -67,20 +213,19 @@ bool CFileListModel::setData(const QModelIndex & index, const QVariant & value,
 		return false;
 	}
 	else
-		return QStandardItemModel::setData(index, value, role);
+		return false;
 }
 
 Qt::ItemFlags CFileListModel::flags(const QModelIndex & idx) const
 {
-	Qt::ItemFlags flags = QStandardItemModel::flags(idx);
-	if (!idx.isValid())
-		return flags;
+	if (!idx.isValid() || (size_t)idx.row() >= _items.size())
+		return Qt::ItemIsDropEnabled; // Dropping onto the empty space of the list
 
-	if (data(index(idx.row(), 0)) != "[..]")
+	Qt::ItemFlags flags = Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+	const CFileSystemObject& item = *_items[(size_t)idx.row()];
+	if (!item.isCdUp())
 		flags |= Qt::ItemIsEditable | Qt::ItemIsDragEnabled;
 
-	const qulonglong hash = itemHash(idx);
-	const CFileSystemObject item = _controller.itemByHash(_panel, hash);
 	if (item.exists() && item.isDir())
 		flags |= Qt::ItemIsDropEnabled;
 
@@ -93,7 +238,7 @@ bool CFileListModel::canDropMimeData(const QMimeData * data, Qt::DropAction /*ac
 		return false;
 
 	const QModelIndex idx = index(row, 0);
-	return !idx.isValid() || _controller.itemByHash(_panel, itemHash(index(row, 0))).isDir();
+	return !idx.isValid() || _items[(size_t)row]->isDir();
 }
 
 QStringList CFileListModel::mimeTypes() const
@@ -108,7 +253,7 @@ bool CFileListModel::dropMimeData(const QMimeData * data, Qt::DropAction action,
 	else if (!data->hasUrls())
 		return false;
 
-	CFileSystemObject dest = parent.isValid() ? _controller.itemByHash(_panel, itemHash(parent)) : CFileSystemObject(_controller.panel(_panel).currentDirPathNative());
+	const CFileSystemObject dest = parent.isValid() ? itemAtRow(parent.row()) : CFileSystemObject(_controller.panel(_panel).currentDirPathNative());
 	assert_and_return_r(dest.exists() && dest.isDir(), false);
 
 	const QList<QUrl> urls(data->urls());
@@ -134,9 +279,9 @@ QMimeData *CFileListModel::mimeData(const QModelIndexList & indexes) const
 	std::set<int> rows;
 	for(const auto& idx: indexes)
 	{
-		if (idx.isValid() && rows.count(idx.row()) == 0)
+		if (idx.isValid() && (size_t)idx.row() < _items.size() && rows.count(idx.row()) == 0)
 		{
-			const QString path = _controller.itemByHash(_panel, itemHash(index(idx.row(), 0))).fullAbsolutePath();
+			const QString path = _items[(size_t)idx.row()]->fullAbsolutePath();
 			if (!path.isEmpty())
 			{
 				rows.insert(idx.row());
@@ -151,12 +296,144 @@ QMimeData *CFileListModel::mimeData(const QModelIndexList & indexes) const
 
 qulonglong CFileListModel::itemHash(const QModelIndex & index) const
 {
-	QStandardItem * itm = item(index.row(), 0);
-	if (!itm)
+	if (!index.isValid() || (size_t)index.row() >= _items.size())
 		return 0;
 
-	bool ok = false;
-	const qulonglong hash = itm->data(Qt::UserRole).toULongLong(&ok);
-	assert_r(ok);
-	return ok ? hash : 0;
+	return _items[(size_t)index.row()]->hash();
+}
+
+// Returns the icon for the row if it has already been loaded, otherwise queues it for loading and returns a placeholder
+QIcon CFileListModel::iconForRow(int row) const
+{
+	const CFileSystemObject& item = *_items[(size_t)row];
+	const qulonglong hash = item.hash();
+	const auto icon = _icons.find(hash);
+	if (icon != _icons.end())
+		return icon->second;
+
+	if (_iconsRequested.insert(hash).second)
+		_iconRequests.push_back(hash);
+
+	loadNextIconBatch();
+	return item.isDir() ? _folderPlaceholderIcon : _filePlaceholderIcon;
+}
+
+// Sends the next batch of icons to be resolved on a worker thread: the rows that have been painted first, then the rest of the listing
+void CFileListModel::loadNextIconBatch() const
+{
+	static const size_t iconBatchSize = 64;
+
+	if (_iconBatchInProgress)
+		return;
+
+	auto objects = std::make_shared<std::vector<CFileSystemObject>>();
+	// The rows that have been painted most recently are the ones most likely to still be on screen
+	while (!_iconRequests.empty() && objects->size() < iconBatchSize)
+	{
+		const qulonglong hash = _iconRequests.back();
+		_iconRequests.pop_back();
+
+		const int row = rowByHash(hash);
+		if (row >= 0 && _icons.count(hash) == 0)
+			objects->push_back(*_items[(size_t)row]);
+	}
+
+	// Prefetching the rest so that scrolling doesn't reveal placeholders
+	while (objects->size() < iconBatchSize && _nextBackgroundIconRow < _items.size())
+	{
+		const CFileSystemObject& item = *_items[_nextBackgroundIconRow++];
+		if (_icons.count(item.hash()) == 0 && _iconsRequested.insert(item.hash()).second)
+			objects->push_back(item);
+	}
+
+	if (objects->empty())
+		return;
+
+	_iconBatchInProgress = true;
+
+	// data() is const, but delivering the icons modifies the model. The model may be gone by the time the batch is delivered.
+	const QPointer<CFileListModel> model(const_cast<CFileListModel*>(this));
+	const uint64_t generation = _iconGeneration;
+	_controller.execOnWorkerThread([model, objects, generation]() {
+		// Only the file system access happens here, the icons themselves can only be created on the UI thread
+		auto iconSources = std::make_shared<std::vector<IconLookupResult>>();
+		iconSources->reserve(objects->size());
+		for (const CFileSystemObject& object: *objects)
+			iconSources->push_back(IconLookupResult{object.hash(), object.properties().modificationDate, CIconProvider::iconSourceForFilesystemObject(object)});
+
+		// Icons are cosmetic, listings and user-initiated results are delivered first
+		CController::get().execOnUiThread([model, iconSources, generation]() {
+			if (model)
+				model->iconBatchLoaded(generation, *iconSources);
+		}, CUiThreadDispatcher::NoTag, CUiThreadDispatcher::LowPriority);
+	}, CTaskScheduler::BackgroundLane);
+}
+
+void CFileListModel::iconBatchLoaded(uint64_t generation, const std::vector<IconLookupResult>& iconSources)
+{
+	_iconBatchInProgress = false;
+
+	if (generation == _iconGeneration)
+	{
+		std::vector<int> rows;
+		rows.reserve(iconSources.size());
+		for (const IconLookupResult& iconSource: iconSources)
+		{
+			const int row = rowByHash(iconSource.hash);
+			// An item that updateItems() has found changed since the batch was queued gets its icon from a later batch
+			if (row < 0 || _items[(size_t)row]->properties().modificationDate != iconSource.modificationDate)
+				continue;
+
+			_icons[iconSource.hash] = CIconProvider::iconFromSource(iconSource.source);
+			rows.push_back(row);
+		}
+
+		// One notification per run of adjacent rows, the rows of a batch may be scattered across the listing
+		std::sort(rows.begin(), rows.end());
+		for (size_t runStart = 0, i = 1; runStart < rows.size(); ++i)
+		{
+			if (i < rows.size() && rows[i] == rows[i - 1] + 1)
+				continue;
+
+			emit dataChanged(index(rows[runStart], NameColumn), index(rows[i - 1], NameColumn), QVector<int>(1, Qt::DecorationRole));
+			runStart = i;
+		}
+	}
+
+	loadNextIconBatch();
+}
+
+void CFileListModel::rebuildRowIndex()
+{
+	_rowByHash.clear();
+	_rowByHash.reserve(_items.size());
+	for (size_t row = 0; row < _items.size(); ++row)
+		_rowByHash[_items[row]->hash()] = (int)row;
+}
+
+QVariant CFileListModel::displayData(const CFileSystemObject& object, int column) const
+{
+	const auto& props = object.properties();
+	switch (column)
+	{
+	case NameColumn:
+		if (props.type == Directory)
+			return QString("[" % (object.isCdUp() ? QString("..") : props.fullName) % "]");
+		else if (props.completeBaseName.isEmpty() && props.type == File) // File without a name, displaying extension in the name field and adding point to extension
+			return QString('.') + props.extension;
+		else
+			return props.completeBaseName;
+	case ExtColumn:
+		if (!props.completeBaseName.isEmpty() && !props.extension.isEmpty())
+			return props.extension;
+		return QVariant();
+	case SizeColumn:
+		if (props.type != Directory || props.size > 0)
+			return _formatter.sizeString(props.size);
+		return QVariant();
+	case DateColumn:
+		return _formatter.dateString(props.modificationDate);
+	default:
+		return QVariant();
+	}
 }
@@ -2,18 +2,27 @@
 #define CFILELISTMODEL_H
 
 #include "cpanel.h"
+#include "displayformatter/cdisplayformatter.h"
+#include "iconprovider/ciconprovider.h"
 
 DISABLE_COMPILER_WARNINGS
-#include <QStandardItemModel>
+#include <QAbstractItemModel>
+#include <QIcon>
 RESTORE_COMPILER_WARNINGS
 
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
 enum Role {
 	FullNameRole = Qt::UserRole+1
 };
 
 class CController;
 class QTreeView;
-class CFileListModel : public QStandardItemModel
+class CFileListModel : public QAbstractItemModel
 {
 	Q_OBJECT
 public:
@@ -24,6 +33,21 @@ public:
 
 	QTreeView * treeView() const;
 
+	// Replaces the contents of the model with a new listing snapshot; nothing is copied, display data is only produced on request in data()
+	void setItems(const std::shared_ptr<const CFileListSnapshot>& snapshot);
+	// Brings the model in line with a new listing snapshot of the same folder by removing, updating and appending individual rows
+	void updateItems(const std::shared_ptr<const CFileListSnapshot>& snapshot);
+	// Returns the object at the specified source row
+	const CFileSystemObject& itemAtRow(int row) const;
+	// Returns the source row of the item with the specified hash, or -1 if there's no such item
+	int rowByHash(qulonglong hash) const;
+
+	QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const override;
+	QModelIndex parent(const QModelIndex & child) const override;
+	int rowCount(const QModelIndex & parent = QModelIndex()) const override;
+	int columnCount(const QModelIndex & parent = QModelIndex()) const override;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
 	QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
 	bool setData(const QModelIndex &index, const QVariant &value, int role) override;
 	Qt::ItemFlags flags(const QModelIndex & index) const override;
@@ -39,10 +63,44 @@ public:
 signals:
 	void itemEdited(qulonglong itemHash, QString newName);
 
+private:
+	// An icon looked up on a worker thread, along with the state of the item it was looked up for
+	struct IconLookupResult
+	{
+		qulonglong                hash;
+		time_t                    modificationDate;
+		CIconProvider::IconSource source;
+	};
+
+	QVariant displayData(const CFileSystemObject& object, int column) const;
+	void rebuildRowIndex();
+
+	// Returns the icon for the row if it has already been loaded, otherwise queues it for loading and returns a placeholder
+	QIcon iconForRow(int row) const;
+	// Sends the next batch of icons to be looked up on a worker thread: the rows that have been painted first, then the rest of the listing
+	void loadNextIconBatch() const;
+	// Creates the icons from what the worker thread has found out, on the UI thread
+	void iconBatchLoaded(uint64_t generation, const std::vector<IconLookupResult>& iconSources);
+
 private:
 	CController & _controller;
 	QTreeView   * _tree;
 	Panel         _panel;
+
+	std::shared_ptr<const CFileListSnapshot> _snapshot; // The listing being displayed; it never changes, so the rows can point into it
+	std::vector<const CFileSystemObject*> _items; // The items of _snapshot by source row
+	std::unordered_map<qulonglong, int> _rowByHash;
+	mutable CDisplayFormatter      _formatter;
+
+// Icons are loaded asynchronously as data() asks for them
+	const QIcon _folderPlaceholderIcon;
+	const QIcon _filePlaceholderIcon;
+	mutable std::unordered_map<qulonglong, QIcon> _icons;
+	mutable std::vector<qulonglong>       _iconRequests; // Items that have been painted with a placeholder, the most recent last
+	mutable std::unordered_set<qulonglong> _iconsRequested; // Items that are either queued or being loaded
+	mutable size_t                        _nextBackgroundIconRow = 0;
+	mutable bool                          _iconBatchInProgress = false;
+	uint64_t                              _iconGeneration = 0; // Incremented whenever the listing is replaced, so that the icons of the previous one are discarded
 };
 
 #endif // CFILELISTMODEL_H
@@ -1,19 +1,39 @@
 #include "cfilelistsortfilterproxymodel.h"
+#include "cfilelistmodel.h"
 #include "ccontroller.h"
+#include "taskscheduler/ctaskscheduler.h"
 #include "../../columns.h"
 
 DISABLE_COMPILER_WARNINGS
-#include <QStandardItemModel>
+#include <QPointer>
 RESTORE_COMPILER_WARNINGS
 
+#include <algorithm>
+#include <functional>
+
+// Listings at least this large are sorted on a worker thread
+static const int asyncSortThreshold = 20000;
+// Listings at least this large are filtered on a worker thread
+static const int asyncFilterThreshold = 100000;
+// No point in splitting the work into chunks smaller than this
+static const size_t minSortChunkSize = 4096;
+
 CFileListSortFilterProxyModel::CFileListSortFilterProxyModel(QObject *parent) :
 	QSortFilterProxyModel(parent),
 	_controller(CController::get()),
 	_panel(UnknownPanel),
-	_sorter(CNaturalSorting(nsaQCollator, SortingOptions()))
+	_collator(naturalCollator()),
+	_emptyKey(_collator.sortKey(QString()))
 {
 }
 
+CFileListSortFilterProxyModel::~CFileListSortFilterProxyModel()
+{
+	// The results of the work in progress are dropped, and the work itself is cut short
+	cancelAsyncSort();
+	cancelQuickFilter();
+}
+
 // Sets the position (left or right) of a panel that this model represents
 void CFileListSortFilterProxyModel::setPanelPosition(Panel p)
 {
@@ -21,9 +41,27 @@ void CFileListSortFilterProxyModel::setPanelPosition(Panel p)
 	_panel = p;
 }
 
-void CFileListSortFilterProxyModel::setSortingOptions(SortingOptions options)
+void CFileListSortFilterProxyModel::setSourceModel(QAbstractItemModel * model)
 {
-	_sorter.setSortingOptions(options);
+	assert_r(!model || dynamic_cast<CFileListModel*>(model));
+	if (model == sourceModel())
+		return;
+
+	if (sourceModel())
+		disconnect(sourceModel(), nullptr, this, nullptr);
+
+	// Connecting before QSortFilterProxyModel does so that the keys are up to date by the time it re-sorts the changed rows
+	if (model)
+	{
+		connect(model, &QAbstractItemModel::modelReset, this, &CFileListSortFilterProxyModel::sourceReset);
+		connect(model, &QAbstractItemModel::layoutChanged, this, &CFileListSortFilterProxyModel::sourceReset);
+		connect(model, &QAbstractItemModel::rowsInserted, this, &CFileListSortFilterProxyModel::sourceRowsInserted);
+		connect(model, &QAbstractItemModel::rowsRemoved, this, &CFileListSortFilterProxyModel::sourceRowsRemoved);
+		connect(model, &QAbstractItemModel::dataChanged, this, &CFileListSortFilterProxyModel::sourceDataChanged);
+	}
+
+	QSortFilterProxyModel::setSourceModel(model);
+	sourceReset();
 }
 
 bool CFileListSortFilterProxyModel::canDropMimeData(const QMimeData * data, Qt::DropAction action, int row, int column, const QModelIndex & parent) const
@@ -34,90 +72,596 @@ bool CFileListSortFilterProxyModel::canDropMimeData(const QMimeData * data, Qt::
 
 void CFileListSortFilterProxyModel::sort(int column, Qt::SortOrder order)
 {
+	if (column >= 0 && asyncSortRequired())
+	{
+		startAsyncSort(column, order);
+		return;
+	}
+
+	cancelAsyncSort();
 	QSortFilterProxyModel::sort(column, order);
+	if (_rowsHiddenUntilSorted)
+	{
+		_rowsHiddenUntilSorted = false;
+		invalidateFilter();
+	}
+
 	emit sorted();
 }
 
+// Only shows the items whose names match the wildcard pattern, an empty pattern shows everything
+void CFileListSortFilterProxyModel::setQuickFilter(const QString& pattern)
+{
+	cancelQuickFilter();
+
+	const auto filter = std::make_shared<const CFileListFilterEngine>(pattern);
+	if (filter->isEmpty())
+	{
+		if (_quickFilter)
+		{
+			_quickFilter.reset();
+			_quickFilterAccepted.clear();
+			invalidateFilter();
+		}
+
+		return;
+	}
+
+	// Typing more characters can only hide rows, so only the ones shown now need to be checked
+	std::shared_ptr<std::vector<int>> candidateRows;
+	if (_quickFilter && filter->refines(*_quickFilter) && _quickFilterAccepted.size() == (size_t)sourceModel()->rowCount())
+	{
+		candidateRows = std::make_shared<std::vector<int>>();
+		for (size_t row = 0; row < _quickFilterAccepted.size(); ++row)
+			if (_quickFilterAccepted[row] != 0)
+				candidateRows->push_back((int)row);
+	}
+
+	startQuickFilter(filter, candidateRows);
+}
+
+// True while a new listing is being sorted on a worker thread; its rows are only shown once they're in order, sorted() is emitted then
+bool CFileListSortFilterProxyModel::rowsHiddenUntilSorted() const
+{
+	return _rowsHiddenUntilSorted;
+}
+
+bool CFileListSortFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const
+{
+	return sourceParent.isValid() || (!_rowsHiddenUntilSorted && quickFilterAccepts(sourceRow));
+}
+
 bool CFileListSortFilterProxyModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
 {
 	assert_r(left.column() == right.column());
 	assert_r(left.isValid() && right.isValid());
 	const int sortColumn = left.column();
+	const bool descendingOrder = sortOrder() == Qt::DescendingOrder;
 
-	QStandardItemModel * srcModel = dynamic_cast<QStandardItemModel*>(sourceModel());
-	QStandardItem * l = srcModel->item(left.row(), left.column());
-	QStandardItem * r = srcModel->item(right.row(), right.column());
+	if (sortColumn == _ranksColumn && sortOrder() == _ranksOrder && _ranks.size() == (size_t)sourceModel()->rowCount())
+	{
+		const int leftRank = _ranks[(size_t)left.row()], rightRank = _ranks[(size_t)right.row()];
+		if (leftRank >= 0 && rightRank >= 0)
+			return descendingOrder ? leftRank > rightRank : leftRank < rightRank;
 
-	if (!l && r)
-		return true;
-	else if (!r && l)
-		return false;
-	else if (!l && !r)
-		return false;
+		// A row that has appeared or changed since the last sort - only a handful of these are compared while the rows are inserted.
+		// The ranks are consistent with the keys because keyLessThan never finds two different rows equivalent.
+		return keyLessThan(makeSortKey(left.row(), sortColumn), makeSortKey(right.row(), sortColumn), sortColumn, descendingOrder);
+	}
+	else if (asyncSortRequired())
+	{
+		// The order is being computed on a worker thread, keeping the source order in the meantime
+		return descendingOrder ? left.row() > right.row() : left.row() < right.row();
+	}
 
-	const qulonglong leftHash = l->data(Qt::UserRole).toULongLong();
-	const qulonglong rightHash = r->data(Qt::UserRole).toULongLong();
+	const std::vector<SortKey>& keys = sortKeys(sortColumn);
+	assert_and_return_r((size_t)left.row() < keys.size() && (size_t)right.row() < keys.size(), false);
+	return keyLessThan(keys[(size_t)left.row()], keys[(size_t)right.row()], sortColumn, descendingOrder);
+}
 
-	const CFileSystemObject leftItem = _controller.itemByHash(_panel, leftHash), rightItem = _controller.itemByHash(_panel, rightHash);
+QCollator CFileListSortFilterProxyModel::naturalCollator()
+{
+	// Natural, case-insensitive order
+	QCollator collator;
+	collator.setNumericMode(true);
+	collator.setCaseSensitivity(Qt::CaseInsensitive);
+	return collator;
+}
 
-	const bool descendingOrder = sortOrder() == Qt::DescendingOrder;
+bool CFileListSortFilterProxyModel::keyLessThan(const SortKey& leftItem, const SortKey& rightItem, int sortColumn, bool descendingOrder)
+{
 	// Folders always before files, no matter the sorting column and direction
-	if (leftItem.isDir() && !rightItem.isDir())
+	if (leftItem.isDir && !rightItem.isDir)
 		return !descendingOrder;  // always keep directory on top
-	else if (!leftItem.isDir() && rightItem.isDir())
+	else if (!leftItem.isDir && rightItem.isDir)
 		return descendingOrder;   // always keep directory on top
 
 	// [..] is always on top
-	if (leftItem.isCdUp())
-		return !descendingOrder;
-	else if (rightItem.isCdUp())
-		return descendingOrder;
+	if (leftItem.isCdUp != rightItem.isCdUp)
+		return leftItem.isCdUp ? !descendingOrder : descendingOrder;
 
 	switch (sortColumn)
 	{
 	case NameColumn:
+	{
 		// File name and extension sort is case-insensitive
-		return _sorter.lessThan(leftItem.fullName(), rightItem.fullName());
+		const int nameComparison = leftItem.primary.compare(rightItem.primary);
+		if (nameComparison != 0)
+			return nameComparison < 0;
+	}
 		break;
 	case ExtColumn:
-		if (leftItem.isDir() && rightItem.isDir()) // Sorting directories by name, files - by extension
-			return _sorter.lessThan(leftItem.name(), rightItem.name());
-		else if (!leftItem.isDir() && !rightItem.isDir() && leftItem.extension().isEmpty() && rightItem.extension().isEmpty())
-			return _sorter.lessThan(leftItem.name(), rightItem.name());
-		else
-		{
-			QString leftExt = leftItem.extension(), rightExt = rightItem.extension();
-			QString leftName = leftItem.name(), rightName = rightItem.name();
-			if (rightName.isEmpty())
-			{
-				rightName = rightExt;
-				rightExt.clear();
-			}
-
-			if (leftName.isEmpty())
-			{
-				leftName = leftExt;
-				leftExt.clear();
-			}
+	{
+		// Sorting directories by name, files - by extension, and then by name if the extensions are the same
+		const int extensionComparison = leftItem.primary.compare(rightItem.primary);
+		if (extensionComparison != 0)
+			return extensionComparison < 0;
 
-			if (_sorter.lessThan(leftExt, rightExt))
-				return true;
-			else if (_sorter.lessThan(rightExt, leftExt)) // check if extensions are the same
-				return false;
-			else // if they are - compare by names
-				return _sorter.lessThan(leftName, rightName);
-		}
+		const int nameComparison = leftItem.secondary.compare(rightItem.secondary);
+		if (nameComparison != 0)
+			return nameComparison < 0;
+	}
 		break;
 	case SizeColumn:
-		return leftItem.size() < rightItem.size();
+		if (leftItem.size != rightItem.size)
+			return leftItem.size < rightItem.size;
 		break;
 	case DateColumn:
-		return leftItem.properties().modificationDate < rightItem.properties().modificationDate;
+		if (leftItem.modificationDate != rightItem.modificationDate)
+			return leftItem.modificationDate < rightItem.modificationDate;
 		break;
 	default:
-		break;
+		assert_unconditional_r("Unhandled code path");
+		return false;
+	}
+
+	// Equal by the sorting column: by name, then by the unique hash for the names that only differ in case (or repeat in the flattened view)
+	if (sortColumn == SizeColumn || sortColumn == DateColumn)
+	{
+		const int nameComparison = leftItem.name.compare(rightItem.name, Qt::CaseInsensitive);
+		if (nameComparison != 0)
+			return nameComparison < 0;
+	}
+
+	if (leftItem.name != rightItem.name)
+		return leftItem.name < rightItem.name;
+
+	return leftItem.hash < rightItem.hash;
+}
+
+// Returns the source rows in the order they should be displayed in, or an empty vector if cancelled. Runs on a worker thread.
+std::vector<int> CFileListSortFilterProxyModel::sortedRows(std::vector<SortKey>& keys, const std::vector<CollationTexts>& texts, int column, Qt::SortOrder order, const std::atomic<bool>& cancelled)
+{
+	assert_r(keys.size() == texts.size());
+	std::vector<int> rows(keys.size());
+	for (size_t i = 0; i < rows.size(); ++i)
+		rows[i] = (int)i;
+
+	// QSortFilterProxyModel puts 'a' before 'b' if lessThan(a, b) for the ascending order and if lessThan(b, a) for the descending one
+	const bool descendingOrder = order == Qt::DescendingOrder;
+	const auto comparator = [&keys, column, descendingOrder](int a, int b) {
+		return descendingOrder ? keyLessThan(keys[(size_t)b], keys[(size_t)a], column, true) : keyLessThan(keys[(size_t)a], keys[(size_t)b], column, false);
+	};
+
+	// Every task builds the collation keys for its chunk and sorts it, then the sorted chunks are merged pairwise
+	CTaskScheduler& scheduler = CTaskScheduler::get();
+	const size_t numThreads = std::max<size_t>(1, std::min<size_t>(scheduler.threadCount(), rows.size() / minSortChunkSize));
+	const size_t chunkSize = (rows.size() + numThreads - 1) / numThreads;
+	std::vector<std::pair<size_t, size_t>> runs;
+	std::vector<std::function<void()>> tasks;
+	for (size_t begin = 0; begin < rows.size(); begin += chunkSize)
+	{
+		const size_t end = std::min(begin + chunkSize, rows.size());
+		runs.emplace_back(begin, end);
+		tasks.emplace_back([&, begin, end]() {
+			const QCollator collator = naturalCollator(); // QCollator instances are not thread-safe
+			for (size_t i = begin; i < end && !cancelled; ++i)
+			{
+				if (!texts[i].first.isEmpty())
+					keys[i].primary = collator.sortKey(texts[i].first);
+				if (!texts[i].second.isEmpty())
+					keys[i].secondary = collator.sortKey(texts[i].second);
+			}
+
+			if (!cancelled)
+				std::stable_sort(rows.begin() + begin, rows.begin() + end, comparator);
+		});
+	}
+
+	// The sort must not take the worker reserved for interactive work, or the listings would wait for it
+	scheduler.parallelInvoke(tasks, CTaskScheduler::BackgroundLane);
+
+	std::vector<int> buffer(rows.size());
+	while (runs.size() > 1 && !cancelled)
+	{
+		tasks.clear();
+		std::vector<std::pair<size_t, size_t>> mergedRuns;
+		for (size_t i = 0; i + 1 < runs.size(); i += 2)
+		{
+			const auto first = runs[i], second = runs[i + 1];
+			mergedRuns.emplace_back(first.first, second.second);
+			tasks.emplace_back([&, first, second]() {
+				std::merge(rows.begin() + first.first, rows.begin() + first.second, rows.begin() + second.first, rows.begin() + second.second, buffer.begin() + first.first, comparator);
+			});
+		}
+
+		if (runs.size() % 2 != 0)
+		{
+			const auto last = runs.back();
+			std::copy(rows.begin() + last.first, rows.begin() + last.second, buffer.begin() + last.first);
+			mergedRuns.push_back(last);
+		}
+
+		scheduler.parallelInvoke(tasks, CTaskScheduler::BackgroundLane);
+
+		rows.swap(buffer);
+		runs.swap(mergedRuns);
+	}
+
+	return cancelled ? std::vector<int>() : rows;
+}
+
+// Returns the sort keys for all the source rows, building them first if the column has changed
+const std::vector<CFileListSortFilterProxyModel::SortKey>& CFileListSortFilterProxyModel::sortKeys(int column) const
+{
+	const int rowCount = sourceModel() ? sourceModel()->rowCount() : 0;
+	if (column != _sortKeysColumn || _sortKeys.size() != (size_t)rowCount)
+	{
+		_sortKeys.clear();
+		_sortKeys.reserve((size_t)rowCount);
+		for (int row = 0; row < rowCount; ++row)
+			_sortKeys.push_back(makeSortKey(row, column));
+
+		_sortKeysColumn = column;
+	}
+
+	return _sortKeys;
+}
+
+CFileListSortFilterProxyModel::SortKey CFileListSortFilterProxyModel::makeSortKey(int sourceRow, int column) const
+{
+	CollationTexts texts;
+	SortKey key = makeSortKeyWithoutCollation(sourceRow, column, texts);
+	if (!texts.first.isEmpty())
+		key.primary = _collator.sortKey(texts.first);
+	if (!texts.second.isEmpty())
+		key.secondary = _collator.sortKey(texts.second);
+
+	return key;
+}
+
+CFileListSortFilterProxyModel::SortKey CFileListSortFilterProxyModel::makeSortKeyWithoutCollation(int sourceRow, int column, CollationTexts& texts) const
+{
+	const CFileSystemObject& item = static_cast<const CFileListModel*>(sourceModel())->itemAtRow(sourceRow);
+	const auto& props = item.properties();
+
+	// Only the column being sorted on needs the (comparatively expensive) collation keys
+	if (column == NameColumn)
+		texts.first = props.fullName;
+	else if (column == ExtColumn)
+	{
+		if (props.type == Directory)
+			texts.first = item.name();
+		else if (props.completeBaseName.isEmpty()) // A file without a name is sorted by its extension as if it was the name
+			texts.second = props.extension;
+		else
+		{
+			texts.first = props.extension;
+			texts.second = props.completeBaseName;
+		}
 	}
 
-	assert_unconditional_r("Unhandled code path");
-	return false;
+	SortKey key(_emptyKey, _emptyKey);
+	key.name = props.fullName;
+	key.hash = props.hash;
+	key.size = props.size;
+	key.modificationDate = props.modificationDate;
+	key.isDir = props.type == Directory;
+	key.isCdUp = item.isCdUp();
+	return key;
+}
+
+// Computes the order on a worker thread; the current order stays on screen until the result is applied
+void CFileListSortFilterProxyModel::startAsyncSort(int column, Qt::SortOrder order)
+{
+	cancelAsyncSort();
+
+	// Only the plain data is collected here, the collation keys are built by the worker
+	const int rowCount = sourceModel()->rowCount();
+	auto keys = std::make_shared<std::vector<SortKey>>();
+	auto texts = std::make_shared<std::vector<CollationTexts>>((size_t)rowCount);
+	keys->reserve((size_t)rowCount);
+	for (int row = 0; row < rowCount; ++row)
+		keys->push_back(makeSortKeyWithoutCollation(row, column, (*texts)[(size_t)row]));
+
+	auto cancelled = std::make_shared<std::atomic<bool>>(false);
+	_asyncSortCancelled = cancelled;
+	const uint64_t revision = _sourceRevision;
+
+	// The model may be gone by the time the result is delivered
+	const QPointer<CFileListSortFilterProxyModel> model(this);
+	_controller.execOnWorkerThread([model, keys, texts, column, order, cancelled, revision]() {
+		auto rows = std::make_shared<std::vector<int>>(sortedRows(*keys, *texts, column, order, *cancelled));
+		if (*cancelled)
+			return;
+
+		CController::get().execOnUiThread([model, rows, column, order, cancelled, revision]() {
+			if (!model || *cancelled)
+				return;
+
+			model->_asyncSortCancelled.reset();
+			if (revision != model->_sourceRevision) // The listing has changed while it was being sorted
+				model->startAsyncSort(column, order);
+			else
+				model->applySortedRows(*rows, column, order);
+		});
+	});
+}
+
+void CFileListSortFilterProxyModel::cancelAsyncSort()
+{
+	if (_asyncSortCancelled)
+	{
+		*_asyncSortCancelled = true;
+		_asyncSortCancelled.reset();
+	}
+}
+
+void CFileListSortFilterProxyModel::applySortedRows(const std::vector<int>& rows, int column, Qt::SortOrder order)
+{
+	_ranks.assign(rows.size(), -1);
+	for (size_t position = 0; position < rows.size(); ++position)
+		_ranks[(size_t)rows[position]] = (int)position;
+
+	_ranksColumn = column;
+	_ranksOrder = order;
+
+	// lessThan now only compares the ranks, so this re-sort is cheap and results in a single layout change.
+	// QSortFilterProxyModel::sort does nothing if neither the column nor the order have changed, hence invalidate().
+	// A new listing that has been hidden so far appears all at once, already in order.
+	const bool rowsWereHidden = _rowsHiddenUntilSorted;
+	_rowsHiddenUntilSorted = false;
+	if (column == sortColumn() && order == sortOrder())
+		invalidate();
+	else
+	{
+		QSortFilterProxyModel::sort(column, order);
+		if (rowsWereHidden)
+			invalidateFilter();
+	}
+
+	emit sorted();
+}
+
+bool CFileListSortFilterProxyModel::asyncSortRequired() const
+{
+	return sourceModel() && sourceModel()->rowCount() >= asyncSortThreshold;
+}
+
+// Returns the case-folded names of all the source rows, building them first if the source has changed
+std::shared_ptr<const CFileListFilterEngine::Names> CFileListSortFilterProxyModel::filterNames()
+{
+	if (!_filterNames)
+	{
+		const CFileListModel * srcModel = static_cast<const CFileListModel*>(sourceModel());
+		auto names = std::make_shared<CFileListFilterEngine::Names>();
+		for (int row = 0, rowCount = srcModel->rowCount(); row < rowCount; ++row)
+			names->append(srcModel->itemAtRow(row).fullName());
+
+		_filterNames = names;
+	}
+
+	return _filterNames;
+}
+
+// Matches either all the rows or only the candidates; large listings are processed on a worker thread while the current result stays on screen
+void CFileListSortFilterProxyModel::startQuickFilter(const std::shared_ptr<const CFileListFilterEngine>& filter, const std::shared_ptr<const std::vector<int>>& candidateRows)
+{
+	cancelQuickFilter();
+
+	const auto names = filterNames();
+	const size_t numRowsToCheck = candidateRows ? candidateRows->size() : names->size();
+	if (numRowsToCheck < (size_t)asyncFilterThreshold)
+	{
+		const std::atomic<bool> notCancelled(false);
+		applyQuickFilter(filter, filter->matchingRows(*names, candidateRows.get(), notCancelled));
+		return;
+	}
+
+	auto cancelled = std::make_shared<std::atomic<bool>>(false);
+	_quickFilterCancelled = cancelled;
+	const uint64_t revision = _sourceRevision;
+
+	// The model may be gone by the time the result is delivered
+	const QPointer<CFileListSortFilterProxyModel> model(this);
+	_controller.execOnWorkerThread([model, filter, names, candidateRows, cancelled, revision]() {
+		auto rows = std::make_shared<std::vector<int>>(filter->matchingRows(*names, candidateRows.get(), *cancelled));
+		if (*cancelled)
+			return;
+
+		CController::get().execOnUiThread([model, filter, rows, cancelled, revision]() {
+			if (!model || *cancelled)
+				return;
+
+			model->_quickFilterCancelled.reset();
+			if (revision != model->_sourceRevision) // The listing has changed in the meantime, the candidates are no longer valid
+				model->startQuickFilter(filter, std::shared_ptr<const std::vector<int>>());
+			else
+				model->applyQuickFilter(filter, *rows);
+		});
+	});
+}
+
+void CFileListSortFilterProxyModel::cancelQuickFilter()
+{
+	if (_quickFilterCancelled)
+	{
+		*_quickFilterCancelled = true;
+		_quickFilterCancelled.reset();
+	}
+}
+
+void CFileListSortFilterProxyModel::applyQuickFilter(const std::shared_ptr<const CFileListFilterEngine>& filter, const std::vector<int>& matchingRows)
+{
+	_quickFilter = filter;
+	setQuickFilterResult(matchingRows);
+	invalidateFilter();
+}
+
+void CFileListSortFilterProxyModel::setQuickFilterResult(const std::vector<int>& matchingRows)
+{
+	_quickFilterAccepted.assign((size_t)sourceModel()->rowCount(), 0);
+	for (const int row: matchingRows)
+		_quickFilterAccepted[(size_t)row] = 1;
+}
+
+bool CFileListSortFilterProxyModel::quickFilterAccepts(int sourceRow) const
+{
+	if (!_quickFilter)
+		return true;
+	else if ((size_t)sourceRow < _quickFilterAccepted.size())
+		return _quickFilterAccepted[(size_t)sourceRow] != 0;
+	else if (_quickFilterCancelled) // A new listing is being filtered on a worker thread, showing everything until it's done
+		return true;
+	else
+		return _quickFilter->matches(static_cast<const CFileListModel*>(sourceModel())->itemAtRow(sourceRow).fullName());
+}
+
+void CFileListSortFilterProxyModel::sourceReset()
+{
+	++_sourceRevision;
+	_filterNames.reset();
+	_quickFilterAccepted.clear();
+	if (_quickFilter && sourceModel())
+	{
+		// QSortFilterProxyModel hasn't processed the reset yet and will re-evaluate every row on its own, so only the result is updated here
+		if (sourceModel()->rowCount() < asyncFilterThreshold)
+		{
+			const std::atomic<bool> notCancelled(false);
+			setQuickFilterResult(_quickFilter->matchingRows(*filterNames(), nullptr, notCancelled));
+		}
+		else
+			startQuickFilter(_quickFilter, std::shared_ptr<const std::vector<int>>());
+	}
+
+	_sortKeys.clear();
+	_sortKeysColumn = -1;
+	_ranks.clear();
+	_ranksColumn = -1;
+
+	// Showing the new listing in the source order until it's sorted would look like a flicker, so its rows are hidden in the meantime.
+	// QSortFilterProxyModel processes the reset after this method, so the rows are filtered out right away.
+	if (sortColumn() >= 0 && asyncSortRequired())
+	{
+		_rowsHiddenUntilSorted = true;
+		startAsyncSort(sortColumn(), sortOrder());
+	}
+	else
+	{
+		_rowsHiddenUntilSorted = false;
+		cancelAsyncSort();
+	}
+}
+
+void CFileListSortFilterProxyModel::sourceRowsInserted(const QModelIndex& parent, int first, int last)
+{
+	if (parent.isValid())
+		return;
+
+	++_sourceRevision;
+	_filterNames.reset();
+	if (!_quickFilterAccepted.empty())
+	{
+		if ((size_t)first <= _quickFilterAccepted.size())
+		{
+			std::vector<char> accepted;
+			for (int row = first; row <= last; ++row)
+				accepted.push_back(_quickFilter->matches(static_cast<const CFileListModel*>(sourceModel())->itemAtRow(row).fullName()) ? 1 : 0);
+			_quickFilterAccepted.insert(_quickFilterAccepted.begin() + first, accepted.begin(), accepted.end());
+		}
+		else
+			_quickFilterAccepted.clear();
+	}
+
+	if (!_ranks.empty())
+	{
+		if ((size_t)first <= _ranks.size())
+			_ranks.insert(_ranks.begin() + first, (size_t)(last - first + 1), -1);
+		else
+			_ranks.clear();
+	}
+
+	if (_sortKeysColumn < 0)
+		return;
+
+	if ((size_t)first > _sortKeys.size())
+	{
+		_sortKeys.clear();
+		_sortKeysColumn = -1;
+		return;
+	}
+
+	std::vector<SortKey> newKeys;
+	newKeys.reserve((size_t)(last - first + 1));
+	for (int row = first; row <= last; ++row)
+		newKeys.push_back(makeSortKey(row, _sortKeysColumn));
+
+	_sortKeys.insert(_sortKeys.begin() + first, newKeys.begin(), newKeys.end());
+}
+
+void CFileListSortFilterProxyModel::sourceRowsRemoved(const QModelIndex& parent, int first, int last)
+{
+	if (parent.isValid())
+		return;
+
+	++_sourceRevision;
+	_filterNames.reset();
+	if (!_quickFilterAccepted.empty())
+	{
+		if ((size_t)last < _quickFilterAccepted.size())
+			_quickFilterAccepted.erase(_quickFilterAccepted.begin() + first, _quickFilterAccepted.begin() + last + 1);
+		else
+			_quickFilterAccepted.clear();
+	}
+
+	if (!_ranks.empty())
+	{
+		if ((size_t)last < _ranks.size())
+			_ranks.erase(_ranks.begin() + first, _ranks.begin() + last + 1);
+		else
+			_ranks.clear();
+	}
+
+	if (_sortKeysColumn < 0)
+		return;
+
+	if ((size_t)last >= _sortKeys.size())
+	{
+		_sortKeys.clear();
+		_sortKeysColumn = -1;
+		return;
+	}
+
+	_sortKeys.erase(_sortKeys.begin() + first, _sortKeys.begin() + last + 1);
+}
+
+void CFileListSortFilterProxyModel::sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles)
+{
+	// Icons arriving don't affect the order
+	if (roles.size() == 1 && roles.front() == Qt::DecorationRole)
+		return;
+
+	++_sourceRevision;
+	_filterNames.reset();
+	for (int row = topLeft.row(); row <= bottomRight.row() && (size_t)row < _quickFilterAccepted.size(); ++row)
+		_quickFilterAccepted[(size_t)row] = _quickFilter->matches(static_cast<const CFileListModel*>(sourceModel())->itemAtRow(row).fullName()) ? 1 : 0;
+
+	for (int row = topLeft.row(); row <= bottomRight.row() && (size_t)row < _ranks.size(); ++row)
+		_ranks[(size_t)row] = -1;
+
+	if (_sortKeysColumn < 0)
+		return;
+
+	for (int row = topLeft.row(); row <= bottomRight.row() && (size_t)row < _sortKeys.size(); ++row)
+		_sortKeys[(size_t)row] = makeSortKey(row, _sortKeysColumn);
 }
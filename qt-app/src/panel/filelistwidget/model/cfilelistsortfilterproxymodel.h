@@ -1,12 +1,18 @@
 #pragma once
 
 #include "cpanel.h"
-#include "utils/naturalsorting/cnaturalsorting.h"
+#include "cfilelistfilterengine.h"
 
 DISABLE_COMPILER_WARNINGS
+#include <QCollator>
 #include <QSortFilterProxyModel>
 RESTORE_COMPILER_WARNINGS
 
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
 class CController;
 
 class CFileListSortFilterProxyModel : public QSortFilterProxyModel
@@ -15,25 +21,99 @@ class CFileListSortFilterProxyModel : public QSortFilterProxyModel
 
 public:
 	explicit CFileListSortFilterProxyModel(QObject * parent);
+	~CFileListSortFilterProxyModel();
 	// Sets the position (left or right) of a panel that this model represents
 	void setPanelPosition(Panel p);
 
-	void setSortingOptions(SortingOptions options);
+	void setSourceModel(QAbstractItemModel * sourceModel) override;
 
 // Drag and drop
 	bool canDropMimeData(const QMimeData * data, Qt::DropAction action, int row, int column, const QModelIndex & parent) const override;
 
 	void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
 
+	// Only shows the items whose names match the wildcard pattern, an empty pattern shows everything
+	void setQuickFilter(const QString& pattern);
+
+	// True while a new listing is being sorted on a worker thread; its rows are only shown once they're in order, sorted() is emitted then
+	bool rowsHiddenUntilSorted() const;
+
 signals:
 	void sorted();
 
 protected:
 	bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
+	bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
+
+private:
+	// Everything lessThan needs to know about a row, derived once from its CFileSystemObject
+	struct SortKey {
+		SortKey(const QCollatorSortKey& primaryKey, const QCollatorSortKey& secondaryKey) : primary(primaryKey), secondary(secondaryKey) {}
+
+		QCollatorSortKey primary;   // Full name for the name column, extension for the extension column (name for folders)
+		QCollatorSortKey secondary; // Name for the extension column
+		QString  name;     // Tie-breakers, so that no two different rows compare as equivalent
+		qulonglong hash = 0;
+		uint64_t size = 0;
+		time_t   modificationDate = 0;
+		bool     isDir = false;
+		bool     isCdUp = false;
+	};
+
+	typedef std::pair<QString, QString> CollationTexts; // The strings for SortKey::primary and SortKey::secondary
+
+	static QCollator naturalCollator();
+	static bool keyLessThan(const SortKey& left, const SortKey& right, int column, bool descendingOrder);
+	// Returns the source rows in the order they should be displayed in, or an empty vector if cancelled. Runs on a worker thread.
+	static std::vector<int> sortedRows(std::vector<SortKey>& keys, const std::vector<CollationTexts>& texts, int column, Qt::SortOrder order, const std::atomic<bool>& cancelled);
+
+	// Returns the sort keys for all the source rows, building them first if the column has changed
+	const std::vector<SortKey>& sortKeys(int column) const;
+	SortKey makeSortKey(int sourceRow, int column) const;
+	SortKey makeSortKeyWithoutCollation(int sourceRow, int column, CollationTexts& texts) const;
+
+	// Computes the order on a worker thread; the current order stays on screen until the result is applied
+	void startAsyncSort(int column, Qt::SortOrder order);
+	void cancelAsyncSort();
+	void applySortedRows(const std::vector<int>& rows, int column, Qt::SortOrder order);
+	bool asyncSortRequired() const;
+
+	// Returns the case-folded names of all the source rows, building them first if the source has changed
+	std::shared_ptr<const CFileListFilterEngine::Names> filterNames();
+	// Matches either all the rows or only the candidates; large listings are processed on a worker thread while the current result stays on screen
+	void startQuickFilter(const std::shared_ptr<const CFileListFilterEngine>& filter, const std::shared_ptr<const std::vector<int>>& candidateRows);
+	void cancelQuickFilter();
+	void applyQuickFilter(const std::shared_ptr<const CFileListFilterEngine>& filter, const std::vector<int>& matchingRows);
+	void setQuickFilterResult(const std::vector<int>& matchingRows);
+	bool quickFilterAccepts(int sourceRow) const;
+
+	void sourceReset();
+	void sourceRowsInserted(const QModelIndex& parent, int first, int last);
+	void sourceRowsRemoved(const QModelIndex& parent, int first, int last);
+	void sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles);
 
 private:
 	CController   & _controller;
 	Panel           _panel;
-	CNaturalSorting _sorter;
+	QCollator       _collator;
+	QCollatorSortKey _emptyKey;
+
+	// Indexed by source row, only valid for _sortKeysColumn
+	mutable std::vector<SortKey> _sortKeys;
+	mutable int                  _sortKeysColumn = -1;
+
+	// Position of each source row in the last asynchronously computed order, -1 for rows added or changed since
+	std::vector<int>             _ranks;
+	int                          _ranksColumn = -1;
+	Qt::SortOrder                _ranksOrder = Qt::AscendingOrder;
+
+	std::shared_ptr<std::atomic<bool>> _asyncSortCancelled; // Set for the sort currently in progress, if any
+	bool                         _rowsHiddenUntilSorted = false; // A new listing is not shown in the source order while it's being sorted
+
+	std::shared_ptr<const CFileListFilterEngine> _quickFilter; // The filter currently applied
+	std::vector<char>            _quickFilterAccepted; // Indexed by source row; empty while a new listing is being filtered on a worker thread
+	std::shared_ptr<std::atomic<bool>> _quickFilterCancelled; // Set for the filtering currently in progress, if any
+	std::shared_ptr<const CFileListFilterEngine::Names> _filterNames;
+	uint64_t                     _sourceRevision = 0; // Incremented on every change of the source, so that outdated sort results can be detected
 };
 
@@ -3,6 +3,8 @@
 #include "../cmainwindow.h"
 #include "cpromptdialog.h"
 #include "filesystemhelperfunctions.h"
+#include "settingsstore/csettingsstore.h"
+#include "settings.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QCloseEvent>
@@ -47,6 +49,9 @@ CCopyMoveDialog::CCopyMoveDialog(Operation operation, std::vector<CFileSystemObj
 	connect(&_eventsProcessTimer, &QTimer::timeout, this, &CCopyMoveDialog::processEvents);
 
 	_performer->setWatcher(this);
+	CSettingsStore& s = CSettingsStore::get();
+	_performer->setPreserveHardlinks(s.value(KEY_OPERATIONS_PRESERVE_HARDLINKS, false).toBool());
+	_performer->setOverwriteChangedBlocksOnly(s.value(KEY_OPERATIONS_OVERWRITE_CHANGED_BLOCKS_ONLY, false).toBool());
 	_performer->start();
 }
 
@@ -2,7 +2,7 @@
 #include "ui_cpromptdialog.h"
 #include "filesystemhelperfunctions.h"
 #include "widgets/widgetutils.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 #include "settings.h"
 
 DISABLE_COMPILER_WARNINGS
@@ -146,7 +146,7 @@ QString CPromptDialog::newName() const
 
 void CPromptDialog::showEvent(QShowEvent * e)
 {
-	restoreGeometry(CSettings().value(KEY_PROMPT_DIALOG_GEOMETRY).toByteArray());
+	restoreGeometry(CSettingsStore::get().value(KEY_PROMPT_DIALOG_GEOMETRY).toByteArray());
 
 	QDialog::showEvent(e);
 
@@ -158,7 +158,7 @@ void CPromptDialog::showEvent(QShowEvent * e)
 
 void CPromptDialog::hideEvent(QHideEvent* e)
 {
-	CSettings().setValue(KEY_PROMPT_DIALOG_GEOMETRY, saveGeometry());
+	CSettingsStore::get().setValue(KEY_PROMPT_DIALOG_GEOMETRY, saveGeometry());
 	QDialog::hideEvent(e);
 }
 
@@ -1,7 +1,7 @@
 #include "csettingspageedit.h"
 #include "ui_csettingspageedit.h"
 #include "settings.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 
 #include <QFileDialog>
 
@@ -13,7 +13,7 @@ CSettingsPageEdit::CSettingsPageEdit(QWidget *parent) :
 	ui->setupUi(this);
 	connect(ui->_btnEditorBrowse, &QPushButton::clicked, this, &CSettingsPageEdit::browseForEditor);
 
-	ui->_editorNameLine->setText(CSettings().value(KEY_EDITOR_PATH).toString());
+	ui->_editorNameLine->setText(CSettingsStore::get().value(KEY_EDITOR_PATH).toString());
 }
 
 CSettingsPageEdit::~CSettingsPageEdit()
@@ -23,7 +23,7 @@ CSettingsPageEdit::~CSettingsPageEdit()
 
 void CSettingsPageEdit::acceptSettings()
 {
-	CSettings().setValue(KEY_EDITOR_PATH, ui->_editorNameLine->text());
+	CSettingsStore::get().setValue(KEY_EDITOR_PATH, ui->_editorNameLine->text());
 }
 
 void CSettingsPageEdit::browseForEditor()
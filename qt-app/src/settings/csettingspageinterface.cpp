@@ -2,7 +2,7 @@
 #include "ui_csettingspageinterface.h"
 
 #include "settings.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 
 CSettingsPageInterface::CSettingsPageInterface(QWidget *parent) :
 	CSettingsPage(parent),
@@ -10,9 +10,10 @@ CSettingsPageInterface::CSettingsPageInterface(QWidget *parent) :
 {
 	ui->setupUi(this);
 
-	ui->_cbRespectLastCursorPos->setChecked(CSettings().value(KEY_INTERFACE_RESPECT_LAST_CURSOR_POS, false).toBool());
-	ui->_cbSortingNumbersAfterLetters->setChecked(CSettings().value(KEY_INTERFACE_NUMBERS_AFFTER_LETTERS, false).toBool());
-	ui->_cbDecoratedFolderIcons->setChecked(CSettings().value(KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS, false).toBool());
+	ui->_cbRespectLastCursorPos->setChecked(CSettingsStore::get().value(KEY_INTERFACE_RESPECT_LAST_CURSOR_POS, false).toBool());
+	ui->_cbSortingNumbersAfterLetters->setChecked(CSettingsStore::get().value(KEY_INTERFACE_NUMBERS_AFFTER_LETTERS, false).toBool());
+	ui->_cbDecoratedFolderIcons->setChecked(CSettingsStore::get().value(KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS, false).toBool());
+	ui->_cbPrefetchFolderUnderCursor->setChecked(CSettingsStore::get().value(KEY_INTERFACE_PREFETCH_FOLDER_UNDER_CURSOR, false).toBool());
 }
 
 CSettingsPageInterface::~CSettingsPageInterface()
@@ -22,7 +23,8 @@ CSettingsPageInterface::~CSettingsPageInterface()
 
 void CSettingsPageInterface::acceptSettings()
 {
-	CSettings().setValue(KEY_INTERFACE_RESPECT_LAST_CURSOR_POS, ui->_cbRespectLastCursorPos->isChecked());
-	CSettings().setValue(KEY_INTERFACE_NUMBERS_AFFTER_LETTERS, ui->_cbSortingNumbersAfterLetters->isChecked());
-	CSettings().setValue(KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS, ui->_cbDecoratedFolderIcons->isChecked());
+	CSettingsStore::get().setValue(KEY_INTERFACE_RESPECT_LAST_CURSOR_POS, ui->_cbRespectLastCursorPos->isChecked());
+	CSettingsStore::get().setValue(KEY_INTERFACE_NUMBERS_AFFTER_LETTERS, ui->_cbSortingNumbersAfterLetters->isChecked());
+	CSettingsStore::get().setValue(KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS, ui->_cbDecoratedFolderIcons->isChecked());
+	CSettingsStore::get().setValue(KEY_INTERFACE_PREFETCH_FOLDER_UNDER_CURSOR, ui->_cbPrefetchFolderUnderCursor->isChecked());
 }
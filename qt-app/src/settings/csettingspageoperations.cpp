@@ -1,6 +1,6 @@
 #include "csettingspageoperations.h"
 #include "ui_csettingspageoperations.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 #include "settings.h"
 
 CSettingsPageOperations::CSettingsPageOperations(QWidget *parent) :
@@ -8,8 +8,10 @@ CSettingsPageOperations::CSettingsPageOperations(QWidget *parent) :
 	ui(new Ui::CSettingsPageOperations)
 {
 	ui->setupUi(this);
-	CSettings s;
+	CSettingsStore& s = CSettingsStore::get();
 	ui->_cbPromptForCopyOrMove->setChecked(s.value(KEY_OPERATIONS_ASK_FOR_COPY_MOVE_CONFIRMATION, true).toBool());
+	ui->_cbPreserveHardlinks->setChecked(s.value(KEY_OPERATIONS_PRESERVE_HARDLINKS, false).toBool());
+	ui->_cbOverwriteChangedBlocksOnly->setChecked(s.value(KEY_OPERATIONS_OVERWRITE_CHANGED_BLOCKS_ONLY, false).toBool());
 }
 
 CSettingsPageOperations::~CSettingsPageOperations()
@@ -19,6 +21,8 @@ CSettingsPageOperations::~CSettingsPageOperations()
 
 void CSettingsPageOperations::acceptSettings()
 {
-	CSettings s;
+	CSettingsStore& s = CSettingsStore::get();
 	s.setValue(KEY_OPERATIONS_ASK_FOR_COPY_MOVE_CONFIRMATION, ui->_cbPromptForCopyOrMove->isChecked());
+	s.setValue(KEY_OPERATIONS_PRESERVE_HARDLINKS, ui->_cbPreserveHardlinks->isChecked());
+	s.setValue(KEY_OPERATIONS_OVERWRITE_CHANGED_BLOCKS_ONLY, ui->_cbOverwriteChangedBlocksOnly->isChecked());
 }
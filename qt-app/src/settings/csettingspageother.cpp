@@ -2,7 +2,7 @@
 #include "ui_csettingspageother.h"
 
 #include "settings.h"
-#include "settings/csettings.h"
+#include "settingsstore/csettingsstore.h"
 #include "ccontroller.h"
 #include "shell/cshell.h"
 
@@ -12,7 +12,7 @@ CSettingsPageOther::CSettingsPageOther(QWidget *parent) :
 {
 	ui->setupUi(this);
 
-	CSettings s;
+	CSettingsStore& s = CSettingsStore::get();
 	ui->_shellCommandName->setText(s.value(KEY_OTHER_SHELL_COMMAND_NAME, CShell::shellExecutable()).toString());
 }
 
@@ -23,6 +23,6 @@ CSettingsPageOther::~CSettingsPageOther()
 
 void CSettingsPageOther::acceptSettings()
 {
-	CSettings s;
+	CSettingsStore& s = CSettingsStore::get();
 	s.setValue(KEY_OTHER_SHELL_COMMAND_NAME, ui->_shellCommandName->text());
 }